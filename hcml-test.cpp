@@ -1,18 +1,711 @@
 #include "hcml.h"
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+void usage( const char * self ) {
+    fprintf(stderr, "Usage: %s [options] <template>\n", self);
+    fprintf(stderr, "       %s -R <registry> [-H <header>]... [-A <params>] [-E <asset>]... <template>...\n", self);
+    fprintf(stderr, "       %s -U <unity.cpp> [-N <files>] [-H <header>]... [-A <params>] <template>...\n", self);
+    fprintf(stderr, "  -p <method>     static string print method, default is resp.write\n");
+    fprintf(stderr, "  -f <method>     flush method, used by cxx:flush and auto flush, default is resp.flush\n");
+    fprintf(stderr, "  -r <method>     reserve method, invoked before cxx:each with static size\n");
+    fprintf(stderr, "  -F <bytes>      auto flush after N bytes of static string\n");
+    fprintf(stderr, "  -m <mode>       render mode, print(default), coroutine or rawbuf\n");
+    fprintf(stderr, "  -j <threads>    parsing threads, -1 to use all cores\n");
+    fprintf(stderr, "  -G <threads>    generating threads, -1 to use all cores\n");
+    fprintf(stderr, "  -P <level>      render probes, 1 to count executions and bytes, 2 with cycles\n");
+    fprintf(stderr, "  -l              emit #line directives of the template\n");
+    fprintf(stderr, "  -O              fold constant subtrees to static string\n");
+    fprintf(stderr, "  -s <method>     static method, receive the precompressed static template\n");
+    fprintf(stderr, "  -K <type>       key type of constant subscript, constructed with (\"key\", length, hash)\n");
+    fprintf(stderr, "  -v              report generator info and allocations of each compile to stderr\n");
+    fprintf(stderr, "  -o, --out <path>\n");
+    fprintf(stderr, "                  output file, rewritten only when changed, default is stdout.\n");
+    fprintf(stderr, "                  output dir of watch mode, default is the watched dir\n");
+    fprintf(stderr, "  -MD             write a Makefile depfile of the template and its includes\n");
+    fprintf(stderr, "  -MF <file>      depfile path, default is the output with .d\n");
+    fprintf(stderr, "  -MT <target>    target in the depfile, default is the output\n");
+    fprintf(stderr, "  -R <file>       write the registry of all templates, found by name\n");
+    fprintf(stderr, "                  through a perfect hash, hcml_find_render(name, length)\n");
+    fprintf(stderr, "  -E <file>       embed the file in the registry, found by hcml_find_asset(name, length)\n");
+    fprintf(stderr, "  -A <params>     parameters of the render functions and the outlined functions,\n");
+    fprintf(stderr, "                  default is std::ostream &resp\n");
+    fprintf(stderr, "  -L <bytes>      outline top-level statements into functions once N bytes of code,\n");
+    fprintf(stderr, "                  written to <out>.part.inc, include it before the render function\n");
+    fprintf(stderr, "  -S <shards>     spread the outlined functions over N files <out>.part<i>.cpp\n");
+    fprintf(stderr, "  -H <header>     header included by each shard, each unity file and the registry\n");
+    fprintf(stderr, "  -U <file>       write the render functions of all templates into unity files,\n");
+    fprintf(stderr, "                  named as the registry, each template has its own namespace\n");
+    fprintf(stderr, "  -N <files>      unity file count, default is 1, <file> with _<i> before the extension\n");
+    fprintf(stderr, "  -w, --watch <dir>\n");
+    fprintf(stderr, "                  compile all templates in dir and recompile on change\n");
+}
+
+/* 
+    Counting allocator of the library, the size is kept before the block. 
+    Workers of parallel parsing and generating allocate at the same time
+ */
+struct alloc_stats_t {
+    std::atomic< unsigned long long >   count;
+    std::atomic< unsigned long long >   bytes;
+    std::atomic< unsigned long long >   live;
+    std::atomic< unsigned long long >   peak;
+};
+static alloc_stats_t g_alloc;
+static const size_t ALLOC_HEADER = 16;
+
+void alloc_count( size_t size ) {
+    ++g_alloc.count;
+    g_alloc.bytes += size;
+    unsigned long long _live = (g_alloc.live += size);
+    unsigned long long _peak = g_alloc.peak;
+    while ( _live > _peak && !g_alloc.peak.compare_exchange_weak(_peak, _live) );
+}
+
+void * counting_malloc( size_t size, void *ctx ) {
+    (void)ctx;
+    char *_p = (char *)malloc(size + ALLOC_HEADER);
+    if ( _p == NULL ) return NULL;
+    *(size_t *)_p = size;
+    alloc_count(size);
+    return _p + ALLOC_HEADER;
+}
+
+void * counting_realloc( void *ptr, size_t size, void *ctx ) {
+    (void)ctx;
+    if ( ptr == NULL ) return counting_malloc(size, ctx);
+    char *_o = (char *)ptr - ALLOC_HEADER;
+    size_t _osize = *(size_t *)_o;
+    char *_p = (char *)realloc(_o, size + ALLOC_HEADER);
+    if ( _p == NULL ) return NULL;
+    *(size_t *)_p = size;
+    g_alloc.live -= _osize;
+    alloc_count(size);
+    return _p + ALLOC_HEADER;
+}
+
+void counting_free( void *ptr, void *ctx ) {
+    (void)ctx;
+    char *_p = (char *)ptr - ALLOC_HEADER;
+    g_alloc.live -= *(size_t *)_p;
+    free(_p);
+}
+
+/* Start counting a compile, the peak begins with the live bytes */
+void alloc_reset() {
+    g_alloc.count = 0;
+    g_alloc.bytes = 0;
+    g_alloc.peak = g_alloc.live.load();
+}
+
+void alloc_report( const char *name ) {
+    fprintf(stderr, "%s: %llu allocation(s), %llu bytes, peak %llu bytes\n", name, 
+        g_alloc.count.load(), g_alloc.bytes.load(), g_alloc.peak.load());
+}
+
+/* Escape the file name as a C string literal, as the generator does */
+std::string c_escape( const std::string& name ) {
+    std::string _e;
+    for ( size_t _i = 0; _i < name.size(); ++_i ) {
+        switch ( name[_i] ) {
+            case '"': _e += "\\\""; break;
+            case '\\': _e += "\\\\"; break;
+            case '\r': _e += "\\r"; break;
+            case '\n': _e += "\\n"; break;
+            case '\t': _e += "\\t"; break;
+            case '\v': _e += "\\v"; break;
+            case '\f': _e += "\\f"; break;
+            default: _e += name[_i]; break;
+        }
+    }
+    return _e;
+}
+
+/* 
+    Renumber the #line directives back to the generated file in the code 
+    written to the file, the code may be pasted with other code around
+ */
+void sync_line_directives( std::string& code, const std::string& from, const std::string& to ) {
+    std::string _from = " \"" + c_escape(from) + "\"";
+    std::string _to = " \"" + c_escape(to) + "\"";
+    std::string _synced;
+    size_t _pos = 0, _end;
+    int _line = 1;
+    for ( ; _pos < code.size(); _pos = _end + 1, ++_line ) {
+        _end = code.find('\n', _pos);
+        if ( _end == std::string::npos ) _end = code.size();
+        size_t _num = _pos + 6;
+        while ( _num < _end && isdigit((unsigned char)code[_num]) ) ++_num;
+        if ( code.compare(_pos, 6, "#line ") == 0 && _num > _pos + 6 && 
+            _end - _num == _from.size() && code.compare(_num, _from.size(), _from) == 0 
+        ) {
+            _synced += "#line " + std::to_string(_line + 1) + _to;
+        } else {
+            _synced.append(code, _pos, _end - _pos);
+        }
+        if ( _end < code.size() ) _synced += '\n';
+    }
+    code.swap(_synced);
+}
+
+/* 
+    Generated code with the header comment of the source and the content hash,
+    the glue code is numbered as the target file
+ */
+std::string generated_code( hcml_t h, const std::string& target ) {
+    std::string _code = "// Generated by hcml from ";
+    _code += hcml_get_source_name(h);
+    _code += ", content ";
+    _code += hcml_get_output_hash(h);
+    _code += "\n";
+    _code.append(hcml_get_output(h), hcml_get_output_size(h));
+    _code += "\n";
+    if ( hcml_get_line_directives(h) ) sync_line_directives(_code, target, target);
+    return _code;
+}
+
+/* Write the file only when the content changed, keep the mtime for build tools */
+int write_if_changed( const std::string& path, const std::string& content ) {
+    FILE *_f = fopen(path.c_str(), "r");
+    if ( _f != NULL ) {
+        std::string _old;
+        char _buf[4096];
+        size_t _l;
+        while ( (_l = fread(_buf, 1, sizeof(_buf), _f)) > 0 ) _old.append(_buf, _l);
+        fclose(_f);
+        if ( _old == content ) return 0;
+    }
+    _f = fopen(path.c_str(), "w");
+    if ( _f == NULL ) {
+        fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+    fwrite(content.data(), 1, content.size(), _f);
+    fclose(_f);
+    return 1;
+}
+
+/* 
+    Write the outlined functions of last parse beside the output, one file 
+    of static functions or one translation unit per shard. All files are 
+    written even if empty, the build has a fixed list of them
+ */
+int write_outline( hcml_t h, const std::string& out, 
+    const std::vector< const char * >& headers ) {
+    int _shards = hcml_get_outline_shards(h);
+    if ( hcml_get_outline_size(h) == 0 ) return 0;
+    for ( int _i = 0; _i < (_shards > 0 ? _shards : 1); ++_i ) {
+        int _size;
+        const char *_part = hcml_get_outline_code(h, _i, &_size);
+        std::string _code = "// Generated by hcml from ";
+        _code += hcml_get_source_name(h);
+        _code += ", content ";
+        _code += hcml_get_output_hash(h);
+        _code += "\n";
+        std::string _path = out + ".part.inc";
+        if ( _shards > 0 ) {
+            char _suffix[32];
+            snprintf(_suffix, sizeof(_suffix), ".part%d.cpp", _i);
+            _path = out + _suffix;
+            for ( size_t _j = 0; _j < headers.size(); ++_j ) {
+                _code += "#include \"";
+                _code += headers[_j];
+                _code += "\"\n";
+            }
+        }
+        if ( _part != NULL ) _code.append(_part, _size);
+        if ( hcml_get_line_directives(h) ) sync_line_directives(_code, out, _path);
+        if ( write_if_changed(_path, _code) < 0 ) return -1;
+    }
+    return 0;
+}
+
+/* Path of the unity file, the index is inserted before the extension */
+std::string unity_path( const char *unity, int index, int files ) {
+    std::string _path = unity;
+    if ( files <= 1 ) return _path;
+    size_t _dot = _path.rfind('.');
+    size_t _slash = _path.rfind('/');
+    if ( _dot == std::string::npos || (_slash != std::string::npos && _dot < _slash) ) {
+        _dot = _path.size();
+    }
+    char _suffix[32];
+    snprintf(_suffix, sizeof(_suffix), "_%d", index);
+    _path.insert(_dot, _suffix);
+    return _path;
+}
+
+/* 
+    Write the render functions of all templates into the unity files, the 
+    headers are included once per file. A template goes to the smallest file,
+    its outlined functions live in its own namespace
+ */
+int write_unity( hcml_t h, const char *unity, int files, const char *params, 
+    const std::vector< const char * >& headers, char **names, int count, bool verbose ) {
+    char _fn[PATH_MAX + 64];
+    if ( files < 1 ) files = 1;
+    if ( params == NULL ) params = "std::ostream &resp";
+    std::vector< std::string > _codes(files);
+    std::vector< int > _counts(files, 0);
+    /* The outlined functions must be in the same file */
+    hcml_set_outline_shards(h, 0);
+    /* Numbered as the unity file it goes to, when written */
+    hcml_set_line_output(h, unity);
+    for ( int _i = 0; _i < count; ++_i ) {
+        alloc_reset();
+        if ( hcml_parse(h, names[_i]) != HCML_ERR_OK ) {
+            fprintf(stderr, "%s: %s\n", names[_i], hcml_get_errstr(h));
+            return -1;
+        }
+        if ( verbose ) alloc_report(names[_i]);
+        if ( hcml_cxx_render_name(names[_i], _fn, sizeof(_fn)) < 0 ) {
+            fprintf(stderr, "%s: name too long\n", names[_i]);
+            return -1;
+        }
+        std::string _section = "\n// ";
+        _section += names[_i];
+        _section += ", content ";
+        _section += hcml_get_output_hash(h);
+        _section += "\nnamespace hcml_unit_";
+        _section += _fn + 12;
+        _section += " {\n";
+        int _size;
+        const char *_part = hcml_get_outline_code(h, 0, &_size);
+        if ( _part != NULL ) _section.append(_part, _size);
+        _section += "}\nvoid ";
+        _section += _fn;
+        _section += "( ";
+        _section += params;
+        _section += " ) {\nusing namespace hcml_unit_";
+        _section += _fn + 12;
+        _section += ";\n";
+        _section.append(hcml_get_output(h), hcml_get_output_size(h));
+        _section += "}\n";
+        int _f = 0;
+        for ( int _j = 1; _j < files; ++_j ) {
+            if ( _codes[_j].size() < _codes[_f].size() ) _f = _j;
+        }
+        _codes[_f] += _section;
+        ++_counts[_f];
+    }
+    for ( int _f = 0; _f < files; ++_f ) {
+        char _head[128];
+        snprintf(_head, sizeof(_head), "// Unity build generated by hcml, %d template(s)\n", _counts[_f]);
+        std::string _code = _head;
+        for ( size_t _j = 0; _j < headers.size(); ++_j ) {
+            _code += "#include \"";
+            _code += headers[_j];
+            _code += "\"\n";
+        }
+        _code += _codes[_f];
+        std::string _path = unity_path(unity, _f, files);
+        if ( hcml_get_line_directives(h) ) sync_line_directives(_code, unity, _path);
+        if ( write_if_changed(_path, _code) < 0 ) return -1;
+        if ( verbose ) {
+            fprintf(stderr, "%s: %d template(s), %d bytes\n", 
+                _path.c_str(), _counts[_f], (int)_code.size());
+        }
+    }
+    return 0;
+}
+
+/* Escape the path for Makefile */
+std::string make_escape( const char *path ) {
+    std::string _e;
+    for ( ; *path != '\0'; ++path ) {
+        if ( *path == ' ' || *path == '#' ) _e += '\\';
+        else if ( *path == '$' ) _e += '$';
+        _e += *path;
+    }
+    return _e;
+}
+
+/* Write the depfile: the target depends on the source and all its includes */
+int write_depfile( hcml_t h, const char *depfile, const char *target, const char *source ) {
+    std::string _dep = make_escape(target) + ": " + make_escape(source);
+    for ( int _i = 0; _i < hcml_get_include_count(h); ++_i ) {
+        _dep += " \\\n  ";
+        _dep += make_escape(hcml_get_include_path(h, _i));
+    }
+    _dep += "\n";
+    return write_if_changed(depfile, _dep);
+}
+
+/* Compiled template of watch mode */
+struct watch_entry_t {
+    /* Real paths of the included templates */
+    std::vector< std::string >  deps;
+    /* Last generated code */
+    std::string                 output;
+    /* Last compile failed, may be fixed by any change */
+    bool                        failed;
+    watch_entry_t() : failed(false) { }
+};
+
+struct watch_state_t {
+    hcml_t                                  h;
+    std::vector< const char * >             headers;
+    std::string                             root;
+    std::string                             out;
+    std::map< std::string, watch_entry_t >  entries;
+    std::map< int, std::string >            dirs;
+    int                                     fd;
+};
+
+double now_ms() {
+    struct timespec _ts;
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return _ts.tv_sec * 1000.0 + _ts.tv_nsec / 1000000.0;
+}
+
+bool is_template( const std::string& path ) {
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".html") == 0;
+}
+
+/* Output path of the template, the relative path under out dir with .inc */
+std::string watch_output_path( watch_state_t& st, const std::string& path ) {
+    return st.out + path.substr(st.root.size()) + ".inc";
+}
+
+/* Make all parent dirs of the file */
+void make_parent_dirs( const std::string& path ) {
+    size_t _p = 1;
+    while ( (_p = path.find('/', _p)) != std::string::npos ) {
+        mkdir(path.substr(0, _p).c_str(), 0755);
+        ++_p;
+    }
+}
+
+/* Compile the template, the output file is written only when changed */
+void watch_compile( watch_state_t& st, const std::string& path ) {
+    double _begin = now_ms();
+    watch_entry_t& _e = st.entries[path];
+    std::string _out_path = watch_output_path(st, path);
+    hcml_set_line_output(st.h, _out_path.c_str());
+    _e.failed = ( hcml_parse(st.h, path.c_str()) != HCML_ERR_OK );
+    if ( _e.failed ) {
+        fprintf(stderr, "%s: %s\n", path.c_str() + st.root.size() + 1, hcml_get_errstr(st.h));
+        return;
+    }
+    _e.deps.clear();
+    for ( int _i = 0; _i < hcml_get_include_count(st.h); ++_i ) {
+        _e.deps.push_back(hcml_get_include_path(st.h, _i));
+    }
+    std::string _output = generated_code(st.h, _out_path);
+    if ( _output == _e.output ) {
+        fprintf(stderr, "%s: not changed, %.3f ms\n", 
+            path.c_str() + st.root.size() + 1, now_ms() - _begin);
+        return;
+    }
+    _e.output.swap(_output);
+    make_parent_dirs(_out_path);
+    if ( write_if_changed(_out_path, _e.output) < 0 ) return;
+    if ( write_outline(st.h, _out_path, st.headers) < 0 ) return;
+    fprintf(stderr, "%s: compiled, %.3f ms\n", 
+        path.c_str() + st.root.size() + 1, now_ms() - _begin);
+}
+
+/* Watch the dir and compile all templates in it, recursively */
+void watch_add_dir( watch_state_t& st, const std::string& dir ) {
+    DIR *_d = opendir(dir.c_str());
+    if ( _d == NULL ) return;
+#ifdef __linux__
+    int _wd = inotify_add_watch(st.fd, dir.c_str(), 
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+    if ( _wd >= 0 ) st.dirs[_wd] = dir;
+#endif
+    struct dirent *_ent;
+    std::vector< std::string > _subdirs;
+    while ( (_ent = readdir(_d)) != NULL ) {
+        if ( _ent->d_name[0] == '.' ) continue;
+        std::string _path = dir + "/" + _ent->d_name;
+        struct stat _st;
+        if ( stat(_path.c_str(), &_st) != 0 ) continue;
+        /* Do not watch the output */
+        if ( S_ISDIR(_st.st_mode) && _path != st.out ) _subdirs.push_back(_path);
+        else if ( S_ISREG(_st.st_mode) && is_template(_path) ) watch_compile(st, _path);
+    }
+    closedir(_d);
+    for ( size_t _i = 0; _i < _subdirs.size(); ++_i ) watch_add_dir(st, _subdirs[_i]);
+}
+
+/* Recompile the changed templates and the dependents of them */
+void watch_changed( watch_state_t& st, const std::set< std::string >& changed ) {
+    std::set< std::string > _compile;
+    bool _shared = false;
+    for ( std::set< std::string >::const_iterator _c = changed.begin(); _c != changed.end(); ++_c ) {
+        struct stat _st;
+        bool _exists = ( stat(_c->c_str(), &_st) == 0 );
+        for ( std::map< std::string, watch_entry_t >::iterator _e = st.entries.begin(); 
+            _e != st.entries.end(); ++_e 
+        ) {
+            if ( _e->second.failed ) _compile.insert(_e->first);
+            for ( size_t _i = 0; _i < _e->second.deps.size(); ++_i ) {
+                if ( _e->second.deps[_i] != *_c ) continue;
+                _compile.insert(_e->first);
+                _shared = true;
+            }
+        }
+        if ( _exists ) {
+            _compile.insert(*_c);
+        } else if ( st.entries.erase(*_c) > 0 ) {
+            unlink(watch_output_path(st, *_c).c_str());
+            _compile.erase(*_c);
+            fprintf(stderr, "%s: removed\n", _c->c_str() + st.root.size() + 1);
+        }
+    }
+    /* A changed include may have been folded into others in the cache */
+    if ( _shared ) hcml_clear_include_cache(st.h);
+    for ( std::set< std::string >::iterator _p = _compile.begin(); _p != _compile.end(); ++_p ) {
+        watch_compile(st, *_p);
+    }
+}
+
+int watch_main( hcml_t h, const char *dir, const char *out, 
+    const std::vector< const char * >& headers ) {
+#ifdef __linux__
+    char _real[PATH_MAX];
+    watch_state_t _st;
+    _st.h = h;
+    _st.headers = headers;
+    if ( realpath(dir, _real) == NULL ) {
+        fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        return 1;
+    }
+    _st.root = _real;
+    if ( out != NULL ) {
+        mkdir(out, 0755);
+        if ( realpath(out, _real) == NULL ) {
+            fprintf(stderr, "%s: %s\n", out, strerror(errno));
+            return 1;
+        }
+    }
+    _st.out = _real;
+    _st.fd = inotify_init();
+    if ( _st.fd < 0 ) {
+        fprintf(stderr, "inotify: %s\n", strerror(errno));
+        return 1;
+    }
+    watch_add_dir(_st, _st.root);
+    fprintf(stderr, "watching %s, %d template(s)\n", _st.root.c_str(), (int)_st.entries.size());
+
+    char _buf[64 * 1024];
+    for ( ;; ) {
+        ssize_t _l = read(_st.fd, _buf, sizeof(_buf));
+        if ( _l <= 0 ) {
+            if ( _l < 0 && errno == EINTR ) continue;
+            break;
+        }
+        /* All events of one read are handled together */
+        std::set< std::string > _changed;
+        for ( char *_p = _buf; _p < _buf + _l; ) {
+            struct inotify_event *_ev = (struct inotify_event *)_p;
+            _p += sizeof(struct inotify_event) + _ev->len;
+            std::map< int, std::string >::iterator _d = _st.dirs.find(_ev->wd);
+            if ( _d == _st.dirs.end() || _ev->len == 0 || _ev->name[0] == '.' ) continue;
+            std::string _path = _d->second + "/" + _ev->name;
+            if ( _ev->mask & IN_ISDIR ) {
+                if ( (_ev->mask & (IN_CREATE | IN_MOVED_TO)) && _path != _st.out ) {
+                    watch_add_dir(_st, _path);
+                }
+                continue;
+            }
+            /* Wait for the writer to close the file */
+            if ( _ev->mask & IN_CREATE ) continue;
+            if ( is_template(_path) ) _changed.insert(_path);
+        }
+        if ( !_changed.empty() ) watch_changed(_st, _changed);
+    }
+    close(_st.fd);
+    return 0;
+#else
+    (void)h; (void)dir; (void)out; (void)headers;
+    fprintf(stderr, "watch mode needs inotify\n");
+    return 1;
+#endif
+}
+
+int main( int argc, char * argv [] ) {
+    int _opt, _verbose = 0, _i;
+    const char *_watch = NULL, *_out = NULL;
+    const char *_depfile = NULL, *_target = NULL, *_mval;
+    const char *_registry = NULL, *_params = NULL, *_unity = NULL;
+    std::vector< const char * > _assets, _headers;
+    int _outline = 0, _unity_files = 1;
+    bool _md = false;
+    static struct option _long_options[] = {
+        { "watch", required_argument, NULL, 'w' },
+        { "out", required_argument, NULL, 'o' },
+        { NULL, 0, NULL, 0 }
+    };
+    static const char *_optstring = "p:f:r:F:m:M:P:j:G:lOs:K:vw:o:R:A:E:L:S:H:U:N:h";
+
+    /* 
+        Count the allocations only for -v, the allocator is set before any 
+        handler. The scan permutes a copy, -MF and -MT take the next argument
+     */
+    std::vector< char * > _args(argv, argv + argc);
+    opterr = 0;
+    while ( (_opt = getopt_long(argc, &_args[0], _optstring, _long_options, NULL)) != -1 ) {
+        if ( _opt == 'v' ) _verbose = 1;
+    }
+    opterr = 1;
+    optind = 0;
+    if ( _verbose ) hcml_set_allocator(counting_malloc, counting_realloc, counting_free, NULL);
 
-int main( int arg, char * argv [] ) {
     hcml_t _h = hcml_create();
     hcml_set_print_method(_h, "resp.write");
+    hcml_set_flush_method(_h, "resp.flush");
+
+    while ( (_opt = getopt_long(argc, argv, _optstring, _long_options, NULL)) != -1 ) {
+        switch ( _opt ) {
+            case 'p': hcml_set_print_method(_h, optarg); break;
+            case 'f': hcml_set_flush_method(_h, optarg); break;
+            case 'r': hcml_set_reserve_method(_h, optarg); break;
+            case 'F': hcml_set_auto_flush(_h, atoi(optarg)); break;
+            case 'm': 
+                if ( strcmp(optarg, "coroutine") == 0 ) {
+                    hcml_set_render_mode(_h, HCML_RENDER_COROUTINE);
+                } else if ( strcmp(optarg, "rawbuf") == 0 ) {
+                    hcml_set_render_mode(_h, HCML_RENDER_RAWBUF);
+                } else if ( strcmp(optarg, "print") == 0 ) {
+                    hcml_set_render_mode(_h, HCML_RENDER_PRINT);
+                } else {
+                    usage(argv[0]); hcml_destroy(_h); return 1;
+                }
+                break;
+            case 'M':
+                /* -MD, -MF <file>, -MT <target> */
+                _mval = NULL;
+                if ( optarg[0] == 'F' || optarg[0] == 'T' ) {
+                    _mval = ( optarg[1] != '\0' ? optarg + 1 : 
+                        ( optind < argc ? argv[optind++] : NULL ) );
+                }
+                if ( strcmp(optarg, "D") == 0 ) {
+                    _md = true;
+                } else if ( optarg[0] == 'F' && _mval != NULL ) {
+                    _depfile = _mval;
+                } else if ( optarg[0] == 'T' && _mval != NULL ) {
+                    _target = _mval;
+                } else {
+                    usage(argv[0]); hcml_destroy(_h); return 1;
+                }
+                break;
+            case 'j': hcml_set_parse_threads(_h, atoi(optarg)); break;
+            case 'G': hcml_set_generate_threads(_h, atoi(optarg)); break;
+            case 'P': hcml_set_probes(_h, atoi(optarg)); break;
+            case 'l': hcml_set_line_directives(_h, 1); break;
+            case 'O': hcml_set_const_folding(_h, 1); break;
+            case 's': hcml_set_static_method(_h, optarg); break;
+            case 'K': hcml_set_key_type(_h, optarg); break;
+            case 'v': _verbose = 1; break;
+            case 'w': _watch = optarg; break;
+            case 'o': _out = optarg; break;
+            case 'R': _registry = optarg; break;
+            case 'A': _params = optarg; break;
+            case 'E': _assets.push_back(optarg); break;
+            case 'L': _outline = atoi(optarg); break;
+            case 'S': hcml_set_outline_shards(_h, atoi(optarg)); break;
+            case 'H': _headers.push_back(optarg); break;
+            case 'U': _unity = optarg; break;
+            case 'N': _unity_files = atoi(optarg); break;
+            default: usage(argv[0]); hcml_destroy(_h); return 1;
+        }
+    }
+    if ( _outline > 0 ) hcml_set_outline(_h, _outline, _params);
+    if ( _watch != NULL ) {
+        _i = watch_main(_h, _watch, _out, _headers);
+        hcml_destroy(_h);
+        return _i;
+    }
+    if ( _unity != NULL ) {
+        _i = write_unity(_h, _unity, _unity_files, _params, _headers, 
+            argv + optind, argc - optind, _verbose);
+        if ( _i < 0 || _registry == NULL ) {
+            hcml_destroy(_h);
+            return ( _i < 0 ? 1 : 0 );
+        }
+    }
+    if ( _registry != NULL ) {
+        _i = hcml_generate_cxx_registry((hcml_node_t *)_h, 
+            (const char * const *)(argv + optind), argc - optind, 
+            (_assets.empty() ? NULL : &_assets[0]), (int)_assets.size(), _params, 
+            (_headers.empty() ? NULL : &_headers[0]), (int)_headers.size());
+        if ( _i == HCML_ERR_OK ) {
+            std::string _code(hcml_get_output(_h), hcml_get_output_size(_h));
+            if ( write_if_changed(_registry, _code) < 0 ) _i = -1;
+        } else {
+            fprintf(stderr, "%s\n", hcml_get_errstr(_h));
+        }
+        hcml_destroy(_h);
+        return ( _i == HCML_ERR_OK ? 0 : 1 );
+    }
+    if ( optind >= argc ) {
+        usage(argv[0]);
+        hcml_destroy(_h);
+        return 1;
+    }
 
     // Parse the input file
-    int _r = hcml_parse(_h, argv[1]);
+    std::string _gen_path = _out != NULL ? _out : std::string(argv[optind]) + ".inc";
+    hcml_set_line_output(_h, _gen_path.c_str());
+    alloc_reset();
+    int _r = hcml_parse(_h, argv[optind]);
+    if ( _verbose ) alloc_report(argv[optind]);
     if ( _r == HCML_ERR_OK ) {
-        printf("%s\n", hcml_get_output(_h) );
+        std::string _code = generated_code(_h, _gen_path);
+        if ( _out == NULL ) {
+            if ( hcml_get_outline_size(_h) > 0 ) {
+                fprintf(stderr, "%s: the outlined functions need an output file by -o\n", argv[optind]);
+                _r = -1;
+            } else {
+                fwrite(_code.data(), 1, _code.size(), stdout);
+            }
+        } else if ( write_if_changed(_out, _code) < 0 || 
+            write_outline(_h, _out, _headers) < 0 
+        ) {
+            _r = -1;
+        }
     } else {
-        printf("%.*s\n", hcml_get_output_size(_h), hcml_get_errstr(_h) );
+        printf("%s\n", hcml_get_errstr(_h) );
+    }
+    if ( _r == HCML_ERR_OK && _md ) {
+        std::string _default_target = ( _out != NULL ? _out : std::string(argv[optind]) + ".inc" );
+        std::string _default_depfile = _default_target + ".d";
+        if ( write_depfile(_h, 
+            ( _depfile != NULL ? _depfile : _default_depfile.c_str() ),
+            ( _target != NULL ? _target : _default_target.c_str() ),
+            argv[optind]) < 0 
+        ) {
+            _r = -1;
+        }
+    }
+
+    if ( _verbose ) {
+        if ( hcml_is_static(_h) ) {
+            fprintf(stderr, "%s: static, %d bytes, etag %s\n", argv[optind], 
+                hcml_get_static_size(_h), hcml_get_static_etag(_h));
+        }
+        fprintf(stderr, "%s: %d flush point(s)\n", argv[optind], hcml_get_flush_count(_h));
+        if ( hcml_get_outline_count(_h) > 0 ) {
+            fprintf(stderr, "%s: %d outlined function(s)\n", argv[optind], hcml_get_outline_count(_h));
+        }
+        for ( _i = 0; _i < hcml_get_flush_count(_h); ++_i ) {
+            fprintf(stderr, "  flush at line %d\n", hcml_get_flush_line(_h, _i));
+        }
     }
 
     hcml_destroy(_h);
 
-    return 0;
+    return ( _r == HCML_ERR_OK ? 0 : 1 );
 }
\ No newline at end of file
@@ -31,6 +31,12 @@
 #include "hcml.h"
 #include "hcml_def.h"
 #include "hcml_util.h"
+#ifndef __IS_WINDOWS__
+#include <pthread.h>
+#endif
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,78 +45,144 @@ extern "C" {
 const char *__value_true = "true";
 const char *__value_false = "false";
 
-/* Create and init a new prop node */
-struct hcml_prop_t * __malloc_prop( const char * key, int kl ) {
-    struct hcml_prop_t *_p = (struct hcml_prop_t *)malloc(sizeof(struct hcml_prop_t));
-    _p->key = key;
-    _p->kl = kl;
-    _p->value = NULL;
-    _p->vl = 0;
-    _p->n_prop = NULL;
+/* Allocator of the library, NULL to use malloc, realloc and free */
+hcml_malloc_fn __alloc_malloc = NULL;
+hcml_realloc_fn __alloc_realloc = NULL;
+hcml_free_fn __alloc_free = NULL;
+void *__alloc_ctx = NULL;
+
+void hcml_set_allocator( hcml_malloc_fn alloc, hcml_realloc_fn re, hcml_free_fn fr, void *ctx ) {
+    if ( alloc == NULL || re == NULL || fr == NULL ) {
+        alloc = NULL; re = NULL; fr = NULL; ctx = NULL;
+    }
+    __alloc_malloc = alloc;
+    __alloc_realloc = re;
+    __alloc_free = fr;
+    __alloc_ctx = ctx;
+}
+
+void * __hcml_malloc( size_t size ) {
+    if ( __alloc_malloc == NULL ) return malloc(size);
+    return (*__alloc_malloc)(size, __alloc_ctx);
+}
+
+void * __hcml_calloc( size_t count, size_t size ) {
+    void *_p;
+    if ( __alloc_malloc == NULL ) return calloc(count, size);
+    if ( size != 0 && count > (size_t)-1 / size ) return NULL;
+    _p = (*__alloc_malloc)(count * size, __alloc_ctx);
+    if ( _p != NULL ) memset(_p, 0, count * size);
     return _p;
 }
 
-/* Set the prop's value */
-void __set_prop_value( struct hcml_prop_t * p, const char * value, int vl ) {
-    p->value = value;
-    p->vl = vl;
+void * __hcml_realloc( void *ptr, size_t size ) {
+    if ( __alloc_realloc == NULL ) return realloc(ptr, size);
+    return (*__alloc_realloc)(ptr, size, __alloc_ctx);
 }
 
-/* Free a property node and all it's siblings */
-void __free_prop( struct hcml_prop_t * p ) {
-    if ( p == NULL ) return;
-    if ( p->n_prop != NULL ) {
-        __free_prop(p->n_prop);
-        p->n_prop = NULL;
-    }
-    free(p);
+void __hcml_free( void *ptr ) {
+    if ( ptr == NULL ) return;
+    if ( __alloc_free == NULL ) free(ptr);
+    else (*__alloc_free)(ptr, __alloc_ctx);
 }
 
-/* Create and init a new tag node */
-struct hcml_tag_t * __malloc_tag( const char * key, int kl ) {
-    struct hcml_tag_t *_t = (struct hcml_tag_t *)malloc(sizeof(struct hcml_tag_t));
-    _t->data_string = key;
-    _t->dl = kl;
-    _t->is_tag = 1;
-    _t->is_ended = 0;
-    _t->p_root = NULL;
-    _t->c_tag = NULL;
-    _t->n_tag = NULL;
-    _t->f_tag = NULL;
-    return _t;
+char * __hcml_strdup( const char *s ) {
+    size_t _l = strlen(s) + 1;
+    char *_d = (char *)__hcml_malloc(_l);
+    if ( _d != NULL ) memcpy(_d, s, _l);
+    return _d;
 }
 
-/* Create and init a string tag node */
-struct hcml_tag_t * __malloc_string( const char * value, int vl ) {
-    struct hcml_tag_t *_t = (struct hcml_tag_t *)malloc(sizeof(struct hcml_tag_t));
-    _t->data_string = value;
-    _t->dl = vl;
-    _t->is_tag = 0;
-    _t->is_ended = 1;
-    _t->p_root = NULL;
-    _t->c_tag = NULL;
-    _t->n_tag = NULL;
-    _t->f_tag = NULL;
+/* Create an empty node table, the offsets of the nodes are relative to the source */
+struct hcml_node_table_t * __new_node_table( const char *source ) {
+    struct hcml_node_table_t *_t;
+    _t = (struct hcml_node_table_t *)__hcml_calloc(1, sizeof(struct hcml_node_table_t));
+    if ( _t == NULL ) return NULL;
+    _t->source = source;
+    _t->tag_serial = -1;
     return _t;
 }
 
-/* Free a tag node, and all it's properies and children and siblings */
-void __free_tag( struct hcml_tag_t * t ) {
-    if ( t == NULL ) return;
-    if ( t->p_root != NULL ) {
-        __free_prop(t->p_root);
-        t->p_root = NULL;
+/* Create and init a new node at the end of the table, HCML_NODE_NONE when failed to alloc */
+uint32_t __new_node( 
+    hcml_node_t *h, struct hcml_node_table_t *t, int is_tag, const char *data, int dl, int bline 
+) {
+    struct hcml_cnode_t *_n;
+    uint32_t _size;
+    if ( t->node_count == t->node_alloc ) {
+        _size = ( t->node_alloc == 0 ? 64 : t->node_alloc * 2 );
+        _n = (struct hcml_cnode_t *)__hcml_realloc(t->nodes, _size * sizeof(struct hcml_cnode_t));
+        if ( _n == NULL ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Node Table");
+            return HCML_NODE_NONE;
+        }
+        t->nodes = _n;
+        t->node_alloc = _size;
+    }
+    _n = t->nodes + t->node_count;
+    _n->data_off = (uint32_t)(data - t->source);
+    _n->data_len = (uint32_t)dl;
+    _n->parent = HCML_NODE_NONE;
+    _n->child = HCML_NODE_NONE;
+    _n->next = HCML_NODE_NONE;
+    _n->prop = HCML_NODE_NONE;
+    _n->bline = (uint32_t)bline;
+    _n->name_id = HCML_CNAME_NONE;
+    _n->flags = ( is_tag ? HCML_CNODE_TAG : HCML_CNODE_ENDED );
+    _n->prop_count = 0;
+    return t->node_count++;
+}
+
+/* 
+    Append a property to the last node of the table, value is NULL for 
+    the bare key. Return 0 when failed
+ */
+int __new_prop( hcml_node_t *h, struct hcml_node_table_t *t, 
+    const char *key, int kl, const char *value, int vl 
+) {
+    struct hcml_cnode_t *_n = t->nodes + t->node_count - 1;
+    struct hcml_cprop_t *_p;
+    uint32_t _size;
+    if ( _n->prop_count == 0xFF ) {
+        __set_error__(h, HCML_ERR_EPARSE, 
+            "Parse Error: too many properties at line: %d", h->line);
+        return 0;
     }
-    if ( t->c_tag != NULL ) {
-        __free_tag(t->c_tag);
-        t->c_tag = NULL;
+    if ( t->prop_count == t->prop_alloc ) {
+        _size = ( t->prop_alloc == 0 ? 32 : t->prop_alloc * 2 );
+        _p = (struct hcml_cprop_t *)__hcml_realloc(t->props, _size * sizeof(struct hcml_cprop_t));
+        if ( _p == NULL ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Node Table");
+            return 0;
+        }
+        t->props = _p;
+        t->prop_alloc = _size;
     }
-    if ( t->n_tag != NULL ) {
-        __free_tag(t->n_tag);
-        t->n_tag = NULL;
+    _p = t->props + t->prop_count;
+    _p->key_off = (uint32_t)(key - t->source);
+    _p->key_len = (uint32_t)kl;
+    _p->value_off = ( value == NULL ? HCML_NODE_NONE : (uint32_t)(value - t->source) );
+    _p->value_len = ( value == NULL ? 4 : (uint32_t)vl );
+    if ( _n->prop_count++ == 0 ) _n->prop = t->prop_count;
+    ++t->prop_count;
+    return 1;
+}
+
+/* Free the node table, the folded data and the view */
+void __free_node_table( struct hcml_node_table_t *t ) {
+    uint32_t _i;
+    if ( t == NULL ) return;
+    if ( t->fold != NULL ) {
+        for ( _i = 0; _i < t->node_count; ++_i ) __hcml_free(t->fold[_i]);
+        __hcml_free(t->fold);
     }
-    t->f_tag = NULL;
-    free(t);
+    __hcml_free(t->nodes);
+    __hcml_free(t->props);
+    __hcml_free(t->names);
+    __hcml_free(t->view);
+    __hcml_free(t->view_props);
+    __hcml_free((void *)t->name_tags);
+    __hcml_free(t);
 }
 
 void __print_check_escape_char( char c ) {
@@ -128,27 +200,28 @@ void __print_num_string( const char * s, int n ) {
     }
 }
 
-/* Append new tag To current tag list and return the new tag */
-struct hcml_tag_t * __append_tag( 
-    hcml_node_t * h, struct hcml_tag_t * current_tag, struct hcml_tag_t * new_tag 
+/* Append new node To current node and return the new node */
+uint32_t __append_node( 
+    hcml_node_t * h, struct hcml_node_table_t * t, uint32_t current, uint32_t node 
 ) {
-    if ( current_tag != NULL ) {
-        if ( current_tag->is_tag == 1 && current_tag->is_ended == 0 ) {
-            if ( current_tag->c_tag != NULL ) {
+    struct hcml_cnode_t *_c;
+    if ( current != HCML_NODE_NONE && node != HCML_NODE_NONE ) {
+        _c = t->nodes + current;
+        if ( (_c->flags & HCML_CNODE_TAG) && !(_c->flags & HCML_CNODE_ENDED) ) {
+            if ( _c->child != HCML_NODE_NONE ) {
                 /* Which will never happen */
                 __set_error__(h, HCML_ERR_EPARSE, 
                     "Parse Error, UnFormated tag at line: %d", h->line);
-                __free_tag(new_tag);
-                return NULL;
+                return HCML_NODE_NONE;
             }
-            current_tag->c_tag = new_tag;
-            new_tag->f_tag = current_tag;
+            _c->child = node;
+            t->nodes[node].parent = current;
         } else {
-            current_tag->n_tag = new_tag;
-            new_tag->f_tag = current_tag->f_tag;
+            _c->next = node;
+            t->nodes[node].parent = _c->parent;
         }
     }
-    return new_tag;
+    return node;
 }
 
 #define __CHK_LEFT_NOT_ZERO__(...)                                      \
@@ -156,27 +229,35 @@ struct hcml_tag_t * __append_tag(
         "Parse Error: invalidate tag at line: %d", h->line);            \
         __VA_ARGS__; break; }
 
+/* Name of the node in the table being parsed */
+#define __NODE_DATA__(i)        (t->source + t->nodes[i].data_off)
+#define __NODE_DL__(i)          ((int)t->nodes[i].data_len)
 
-/* Parse the code */
-void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
+/* 
+    Parse the code into the node table, the code begins at the line.
+    Return the first node, HCML_NODE_NONE if no node
+ */
+uint32_t __parse_hcml_tree__( 
+    hcml_node_t *h, struct hcml_node_table_t *t, const char *rbuf, int rbufl, int line 
+) {
     int __rindex, __rleft;
-    struct hcml_tag_t *__root_tag, *__current_tag, *__temp_tag;
-    struct hcml_prop_t *__temp_prop, *__temp_prop2;
-    const char *__saved_begin;
+    uint32_t __root_node, __current_node, __temp_node, __parent_node;
+    const char *__saved_begin, *__key, *__value;
+    int __saved_line, __kl, __vl;
     int __flag;
 
     // Empty Content
-    if ( rbufl == 0 ) return;
+    if ( rbufl == 0 ) return HCML_NODE_NONE;
 
     __flag = 0;
     __rindex = 0;
     __rleft = rbufl;
-    __root_tag = NULL;
-    __current_tag = NULL;
-    __temp_tag = NULL;
-    __temp_prop = __temp_prop2 = NULL;
+    __root_node = HCML_NODE_NONE;
+    __current_node = HCML_NODE_NONE;
+    __temp_node = HCML_NODE_NONE;
     __saved_begin = rbuf;
-    h->line = 1;
+    h->line = line;
+    __saved_line = h->line;
 
     while ( __rindex < rbufl ) {
         /* All String */
@@ -188,9 +269,11 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
             /* End of source */
             if ( (rbuf + __rindex - __saved_begin) == 0 ) break;
             /* All string */
-            __temp_tag = __malloc_string(__saved_begin, (rbuf + __rindex - __saved_begin));
-            if ( __root_tag == NULL ) __root_tag = __temp_tag;
-            __current_tag = __append_tag(h, __current_tag, __temp_tag);
+            __temp_node = __new_node(h, t, 0, __saved_begin, (int)(rbuf + __rindex - __saved_begin), 
+                __saved_line);
+            if ( __temp_node == HCML_NODE_NONE ) break;
+            if ( __root_node == HCML_NODE_NONE ) __root_node = __temp_node;
+            __current_node = __append_node(h, t, __current_node, __temp_node);
             break;
         }
 
@@ -204,31 +287,34 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
             if ( strncmp( rbuf + __rindex + 2, h->lang_prefix, h->lang_prefix_l) == 0 ) {
                 /* This is the language tag */
 
-                if ( __current_tag != NULL && __current_tag->is_tag == 1 ) {
+                if ( __current_node != HCML_NODE_NONE && 
+                    (t->nodes[__current_node].flags & HCML_CNODE_TAG) 
+                ) {
                     /* Yes, im a tag */
-                    if ( __current_tag->is_ended == 0 ) {
+                    if ( !(t->nodes[__current_node].flags & HCML_CNODE_ENDED) ) {
                         /* Yes, we are in a tag's content, and it's not ended yet,
                         1 for '<', 1 for current '/', 1 for the '>' after the tag name */
-                        if ( __current_tag->dl <= (__rleft - (2 + h->lang_prefix_l + 1)) ) {
+                        if ( __NODE_DL__(__current_node) <= (__rleft - (2 + h->lang_prefix_l + 1)) ) {
                             /* Yes, we still have enough pending data to read */
                             if ( strncmp(
                                 rbuf + __rindex + 2 + h->lang_prefix_l + 1, 
-                                __current_tag->data_string, 
-                                __current_tag->dl) == 0 
+                                __NODE_DATA__(__current_node), 
+                                __NODE_DL__(__current_node)) == 0 
                             ) {
                                 /* Check if we have unsaved string before we close the tag */
                                 if ( (rbuf + __rindex - __saved_begin) > 0 ) {
                                     /* All string */
-                                    __temp_tag = __malloc_string(__saved_begin, 
-                                        (rbuf + __rindex - __saved_begin));
-                                    __append_tag(h, __current_tag, __temp_tag);
+                                    __temp_node = __new_node(h, t, 0, __saved_begin, 
+                                        (int)(rbuf + __rindex - __saved_begin), __saved_line);
+                                    if ( __temp_node == HCML_NODE_NONE ) break;
+                                    __append_node(h, t, __current_node, __temp_node);
                                 }
                                 /* Yes! this is the end of the tag */
-                                __current_tag->is_ended = 1;
+                                t->nodes[__current_node].flags |= HCML_CNODE_ENDED;
 
                                 /* Skip the end tag </...:xxx> */
-                                __rindex += (2 + h->lang_prefix_l + 1 + __current_tag->dl + 1);
-                                __rleft -= (2 + h->lang_prefix_l + 1 + __current_tag->dl + 1);
+                                __rindex += (2 + h->lang_prefix_l + 1 + __NODE_DL__(__current_node) + 1);
+                                __rleft -= (2 + h->lang_prefix_l + 1 + __NODE_DL__(__current_node) + 1);
                                 /* Skip space after end of tag */
                                 while ( __rleft > 0 && isspace(rbuf[__rindex])) {
                                     if ( rbuf[__rindex] == '\n' ) ++h->line;
@@ -240,47 +326,52 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                                 }
                                 /* Go to check next value */
                                 __saved_begin = (rbuf + __rindex);
+                                __saved_line = h->line;
                                 continue;
                             } else {
                                 __set_error__(h, HCML_ERR_EPARSE,
                                     "Parse Error: Invalidate end tag, mismatch with current unclose: "
                                     "%.*s begtin at line: %d, line: %d", 
-                                    __current_tag->dl,
-                                    __current_tag->data_string, 
-                                    __current_tag->bline, 
+                                    __NODE_DL__(__current_node),
+                                    __NODE_DATA__(__current_node), 
+                                    (int)t->nodes[__current_node].bline, 
                                     h->line);
                                 break;
                             }
                         } else {
                             __set_error__(h, HCML_ERR_EPARSE,
                                 "Parse Error: missing end tag of %s, line: %d", 
-                                __current_tag->data_string, h->line);
+                                __NODE_DATA__(__current_node), h->line);
                             break;
                         }
                     } else {
                         /* check parent tag */
-                        if ( __current_tag->f_tag != NULL && __current_tag->f_tag->is_ended == 0 ) {
-                            if ( __current_tag->f_tag->dl < (__rleft - (2 + h->lang_prefix_l + 1)) ) {
+                        __parent_node = t->nodes[__current_node].parent;
+                        if ( __parent_node != HCML_NODE_NONE && 
+                            !(t->nodes[__parent_node].flags & HCML_CNODE_ENDED) 
+                        ) {
+                            if ( __NODE_DL__(__parent_node) < (__rleft - (2 + h->lang_prefix_l + 1)) ) {
                                 if ( strncmp(
                                     rbuf + __rindex + 2 + h->lang_prefix_l + 1,
-                                    __current_tag->f_tag->data_string,
-                                    __current_tag->f_tag->dl
+                                    __NODE_DATA__(__parent_node),
+                                    __NODE_DL__(__parent_node)
                                     ) == 0 
                                 ) {
                                     /* Check if we have unsaved string before wo close the tag */
                                     if ( (rbuf + __rindex - __saved_begin) > 0 ) {
                                         /* All string */
-                                        __temp_tag = __malloc_string(__saved_begin, 
-                                            (rbuf + __rindex - __saved_begin));
-                                        __append_tag(h, __current_tag, __temp_tag);
+                                        __temp_node = __new_node(h, t, 0, __saved_begin, 
+                                            (int)(rbuf + __rindex - __saved_begin), __saved_line);
+                                        if ( __temp_node == HCML_NODE_NONE ) break;
+                                        __append_node(h, t, __current_node, __temp_node);
                                     }
                                     /* Pop current tag, go up level */
-                                    __current_tag = __current_tag->f_tag;
-                                    __current_tag->is_ended = 1;
+                                    __current_node = __parent_node;
+                                    t->nodes[__current_node].flags |= HCML_CNODE_ENDED;
 
                                     /* Skip the end tag </...:xxx> */
-                                    __rindex += (2 + h->lang_prefix_l + 1 + __current_tag->dl + 1);
-                                    __rleft -= (2 + h->lang_prefix_l + 1 + __current_tag->dl + 1);
+                                    __rindex += (2 + h->lang_prefix_l + 1 + __NODE_DL__(__current_node) + 1);
+                                    __rleft -= (2 + h->lang_prefix_l + 1 + __NODE_DL__(__current_node) + 1);
 
                                     /* Skip space after end of tag */
                                     while ( __rleft > 0 && isspace(rbuf[__rindex])) {
@@ -293,6 +384,7 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                                     }
                                     /* Go back to check next value */
                                     __saved_begin = (rbuf + __rindex);
+                                    __saved_line = h->line;
 
                                     continue;
                                 } else {
@@ -304,9 +396,9 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                                 __set_error__(h, HCML_ERR_EPARSE,
                                     "Parse Error: Invalidate end tag, mismatch with current unclose: "
                                     "%.*s begtin at line: %d, line: %d", 
-                                    __current_tag->f_tag->dl,
-                                    __current_tag->f_tag->data_string, 
-                                    __current_tag->f_tag->bline, 
+                                    __NODE_DL__(__parent_node),
+                                    __NODE_DATA__(__parent_node), 
+                                    (int)t->nodes[__parent_node].bline, 
                                     h->line);
                                 break;
                             }
@@ -340,11 +432,13 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                 /* This is a new tag */
                 if ( (rbuf + __rindex - __saved_begin) > 0 ) {
                     /* We have string before */
-                    __temp_tag = __malloc_string(__saved_begin, (rbuf + __rindex - __saved_begin));
-                    if ( __root_tag == NULL ) __root_tag = __temp_tag;
-                    __current_tag = __append_tag(h, __current_tag, __temp_tag);
+                    __temp_node = __new_node(h, t, 0, __saved_begin, 
+                        (int)(rbuf + __rindex - __saved_begin), __saved_line);
+                    if ( __temp_node == HCML_NODE_NONE ) break;
+                    if ( __root_node == HCML_NODE_NONE ) __root_node = __temp_node;
+                    __current_node = __append_node(h, t, __current_node, __temp_node);
                     /* Error hanppend */
-                    if ( __current_tag == NULL ) break;
+                    if ( __current_node == HCML_NODE_NONE ) break;
                 }
                 /* go on to parse the new tag */
                 __rindex += 1;
@@ -359,12 +453,12 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                     ++__rindex; --__rleft;
                 }
                 __CHK_LEFT_NOT_ZERO__()
-                __temp_tag = __malloc_tag( __saved_begin + h->lang_prefix_l + 1, 
-                    (rbuf + __rindex - __saved_begin - h->lang_prefix_l - 1) );
-                __temp_tag->bline = h->line;
-                if ( __root_tag == NULL ) __root_tag = __temp_tag;
-                __current_tag = __append_tag(h, __current_tag, __temp_tag);
-                if ( __current_tag == NULL ) break;
+                __temp_node = __new_node(h, t, 1, __saved_begin + h->lang_prefix_l + 1, 
+                    (int)(rbuf + __rindex - __saved_begin - h->lang_prefix_l - 1), h->line);
+                if ( __temp_node == HCML_NODE_NONE ) break;
+                if ( __root_node == HCML_NODE_NONE ) __root_node = __temp_node;
+                __current_node = __append_node(h, t, __current_node, __temp_node);
+                if ( __current_node == HCML_NODE_NONE ) break;
 
                 while ( __flag == 0 ) {
                     /* Skip all whitespace */
@@ -395,12 +489,14 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                             ++__rindex; --__rleft;;
                         }
                         __CHK_LEFT_NOT_ZERO__(__flag = 1)
-                        __temp_prop = __malloc_prop(__saved_begin, rbuf + __rindex - __saved_begin);
+                        __key = __saved_begin;
+                        __kl = (int)(rbuf + __rindex - __saved_begin);
 
                         if ( rbuf[__rindex] != '=' ) {
                             if ( isspace(rbuf[__rindex]) || rbuf[__rindex] == '>' ) {
                                 /* Prop = true */
-                                __set_prop_value(__temp_prop, __value_true, 4);
+                                __value = NULL;
+                                __vl = 0;
                             } else {
                                 /* Error */
                                 __set_error__(h, HCML_ERR_EPARSE,
@@ -435,17 +531,13 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                             /* Save last '"' */
                             ++__rindex; --__rleft;
                             /* Set prop value withouth '"' */
-                            __set_prop_value(__temp_prop, __saved_begin + 1, 
-                                rbuf + __rindex - __saved_begin - 2);
+                            __value = __saved_begin + 1;
+                            __vl = (int)(rbuf + __rindex - __saved_begin - 2);
                         }
-                        if ( __current_tag->p_root == NULL ) {
-                            __current_tag->p_root = __temp_prop;
-                        } else {
-                            __temp_prop2 = __current_tag->p_root;
-                            while ( __temp_prop2->n_prop != NULL ) {
-                                __temp_prop2 = __temp_prop2->n_prop;
-                            }
-                            __temp_prop2->n_prop = __temp_prop;
+                        /* The props of the new tag are the last ones of the table */
+                        if ( !__new_prop(h, t, __key, __kl, __value, __vl) ) {
+                            __flag = 1;
+                            break;
                         }
                     } else {
                         // Yes, we meet the '>', end of current tag part
@@ -464,219 +556,1683 @@ void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
                     }
                     __CHK_LEFT_NOT_ZERO__()
                     __saved_begin = rbuf + __rindex;
+                    __saved_line = h->line;
                     continue;
                 }
             } else {
                 ++__rindex; --__rleft;
             }
+        } else {
+            /* Too short to be a tag, still string */
+            ++__rindex; --__rleft;
         }
     }
 
-#ifdef DUMP_AFTER_PARSE
-    hcml_dump_tag( __root_tag, 0 );
+    return __root_node;
+}
+
+/* Piece of the source parsed by a thread */
+struct __parse_piece_t {
+    const char              *buf;
+    int                     len;
+    int                     line;
+    /* Nodes of the piece, the offsets are relative to the whole source */
+    struct hcml_node_table_t    *table;
+    uint32_t                root;
+    /* Private handler to keep the error of the piece */
+    hcml_node_t             node;
+};
+
+/* Pieces shared by the parsing threads */
+struct __parse_pool_t {
+    struct __parse_piece_t  *pieces;
+    int                     count;
+    int                     next;
+#ifndef __IS_WINDOWS__
+    pthread_mutex_t         lock;
 #endif
-    if ( h->langfp != NULL ) {
-        (*(hcml_lang_generator)(h->langfp))(h, __root_tag, "\n");
+};
+
+/* Add a piece begin at buf, return 0 when failed to alloc */
+int __add_parse_piece( struct __parse_piece_t **pieces, int *count, int *size, const char *buf, int line ) {
+    struct __parse_piece_t *_p;
+    if ( *count == *size ) {
+        _p = (struct __parse_piece_t *)__hcml_realloc(*pieces, 
+            sizeof(struct __parse_piece_t) * (*size == 0 ? 16 : *size * 2));
+        if ( _p == NULL ) return 0;
+        *pieces = _p;
+        *size = (*size == 0 ? 16 : *size * 2);
     }
-    __free_tag( __root_tag );
+    _p = *pieces + *count;
+    memset(_p, 0, sizeof(struct __parse_piece_t));
+    _p->buf = buf;
+    _p->line = line;
+    ++(*count);
+    return 1;
 }
 
 /* 
-    Create an hcml handler 
+    First pass of parallel parsing, locate the tags and split the source after
+    the end of top-level tags, each piece is at least target bytes.
+    The scan follows how __parse_hcml_tree__ moves and counts lines, 
+    anything unexpected puts the rest of source into the last piece.
+    Return the piece count, 0 when failed to alloc
  */
-hcml_t hcml_create() {
-    hcml_node_t * _h;
-    _h = (hcml_node_t *)calloc(1, sizeof(hcml_node_t));
-    if ( _h == NULL ) return NULL;
-    /* Deefault is CXX */
-    strcpy(_h->lang_prefix, "cxx");
-    _h->lang_prefix_l = 3;
-    _h->langfp = (void *)&hcml_generate_cxx_lang;
-    _h->exlangfp = NULL;
-    return (hcml_t)_h;
-}
+int __split_hcml_source__( hcml_node_t *h, const char *rbuf, int rbufl, int target, 
+    struct __parse_piece_t **pieces ) 
+{
+    const char *_p = rbuf, *_end = rbuf + rbufl, *_name;
+    const char **_stack = NULL, **_new_stack;
+    int *_stackl = NULL, *_new_stackl, _depth = 0, _stack_size = 0, _line = 1, _count = 0, _size = 0;
+    int _nl, _i, _ok = 1;
+    const char *_pre = h->lang_prefix;
+    int _pl = h->lang_prefix_l;
 
-/* 
-    Destroy an hcml handler and release all dynamic data 
- */
-void hcml_destroy( hcml_t h ) {
-    hcml_node_t * _h = (hcml_node_t *)h;
-    if ( h == NULL ) return;
-    if ( _h->presult != NULL ) {
-        free(_h->presult);
-        _h->presult = NULL;
+    if ( !__add_parse_piece(pieces, &_count, &_size, rbuf, 1) ) return 0;
+    while ( _ok && _p < _end ) {
+        if ( *_p == '\0' ) break;
+        if ( *_p == '\n' ) { ++_line; ++_p; continue; }
+        if ( *_p != '<' ) { ++_p; continue; }
+        if ( _end - _p > 2 + _pl && _p[1] == '/' && strncmp(_p + 2, _pre, _pl) == 0 ) {
+            /* End tag must match the last open one */
+            _name = _p + 2 + _pl + 1;
+            if ( _p[2 + _pl] != ':' || _depth == 0 ) break;
+            _nl = _stackl[_depth - 1];
+            if ( _end - _name <= _nl || strncmp(_name, _stack[_depth - 1], _nl) != 0 ||
+                _name[_nl] != '>' ) break;
+            --_depth;
+            _p = _name + _nl + 1;
+            while ( _p < _end && isspace(*_p) ) { if ( *_p == '\n' ) ++_line; ++_p; }
+            if ( _depth == 0 && _p < _end && (_p - (*pieces)[_count - 1].buf) >= target ) {
+                if ( !__add_parse_piece(pieces, &_count, &_size, _p, _line) ) { _count = 0; break; }
+            }
+            continue;
+        }
+        if ( _end - _p > 7 && _end - _p > 1 + _pl && 
+            strncmp(_p + 1, _pre, _pl) == 0 && _p[1 + _pl] == ':' 
+        ) {
+            /* Begin tag, keep the name */
+            _name = _p + 1 + _pl + 1;
+            for ( _p = _name; _p < _end && !isspace(*_p) && *_p != '>' && *_p != '/'; ++_p );
+            if ( _depth == _stack_size ) {
+                _stack_size = ( _stack_size == 0 ? 32 : _stack_size * 2 );
+                _new_stack = (const char **)__hcml_realloc(_stack, sizeof(const char *) * _stack_size);
+                if ( _new_stack != NULL ) _stack = _new_stack;
+                _new_stackl = (int *)__hcml_realloc(_stackl, sizeof(int) * _stack_size);
+                if ( _new_stackl != NULL ) _stackl = _new_stackl;
+                if ( _new_stack == NULL || _new_stackl == NULL ) { _count = 0; break; }
+            }
+            _stack[_depth] = _name;
+            _stackl[_depth] = (int)(_p - _name);
+            ++_depth;
+            /* Properties, the line in value is not counted */
+            while ( 1 ) {
+                while ( _p < _end && isspace(*_p) ) { if ( *_p == '\n' ) ++_line; ++_p; }
+                if ( _p == _end || *_p == '/' ) { _ok = 0; break; }
+                if ( *_p == '>' ) break;
+                while ( _p < _end && isalpha(*_p) ) ++_p;
+                if ( _p == _end ) { _ok = 0; break; }
+                if ( *_p != '=' ) {
+                    if ( isspace(*_p) || *_p == '>' ) continue;
+                    _ok = 0; 
+                    break;
+                }
+                if ( _end - _p < 2 || _p[1] != '"' ) { _ok = 0; break; }
+                _p += 2;
+                while ( 1 ) {
+                    while ( _p < _end && *_p != '"' ) ++_p;
+                    if ( _p == _end ) break;
+                    if ( _p[-1] == '\\' ) { ++_p; continue; }
+                    break;
+                }
+                if ( _p == _end ) { _ok = 0; break; }
+                ++_p;
+            }
+            if ( !_ok ) break;
+            ++_p;
+            while ( _p < _end && isspace(*_p) ) { if ( *_p == '\n' ) ++_line; ++_p; }
+            continue;
+        }
+        ++_p;
     }
-    _h->bufsize = 0;
-    _h->rsize = 0;
-    free(_h);
+    __hcml_free(_stack);
+    __hcml_free(_stackl);
+    if ( _count > 0 ) {
+        for ( _i = 0; _i < _count; ++_i ) {
+            (*pieces)[_i].len = (int)(( _i + 1 < _count ? (*pieces)[_i + 1].buf : _end ) - 
+                (*pieces)[_i].buf);
+            memcpy((*pieces)[_i].node.lang_prefix, h->lang_prefix, sizeof(h->lang_prefix));
+            (*pieces)[_i].node.lang_prefix_l = h->lang_prefix_l;
+        }
+    }
+    return _count;
 }
 
-/* 
-    Get the output buffer 
- */
-const char * hcml_get_output( hcml_t h ) {
-    return ((hcml_node_t *)h)->presult;
+/* Parsing thread, take the next piece until all done */
+void * __parse_hcml_worker__( void *arg ) {
+    struct __parse_pool_t *_pool = (struct __parse_pool_t *)arg;
+    struct __parse_piece_t *_piece;
+    int _i;
+    while ( 1 ) {
+#ifndef __IS_WINDOWS__
+        pthread_mutex_lock(&_pool->lock);
+#endif
+        _i = _pool->next++;
+#ifndef __IS_WINDOWS__
+        pthread_mutex_unlock(&_pool->lock);
+#endif
+        if ( _i >= _pool->count ) break;
+        _piece = _pool->pieces + _i;
+        _piece->root = __parse_hcml_tree__(&_piece->node, _piece->table, 
+            _piece->buf, _piece->len, _piece->line);
+    }
+    return NULL;
 }
 
-/*
-    Get the last error message 
+/* 
+    Move the nodes of the piece to the end of the table, return the first 
+    node of the piece in the table, HCML_NODE_NONE when failed to alloc
  */
-const char * hcml_get_errstr( hcml_t h ) {
-    return ((hcml_node_t *)h)->errmsg;
+uint32_t __merge_node_table( hcml_node_t *h, struct hcml_node_table_t *t, 
+    struct hcml_node_table_t *piece, uint32_t root 
+) {
+    struct hcml_cnode_t *_n;
+    struct hcml_cprop_t *_p;
+    uint32_t _base = t->node_count, _pbase = t->prop_count, _i;
+    if ( t->node_alloc < t->node_count + piece->node_count ) {
+        _n = (struct hcml_cnode_t *)__hcml_realloc(t->nodes, 
+            (t->node_count + piece->node_count) * sizeof(struct hcml_cnode_t));
+        if ( _n == NULL ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Node Table");
+            return HCML_NODE_NONE;
+        }
+        t->nodes = _n;
+        t->node_alloc = t->node_count + piece->node_count;
+    }
+    if ( t->prop_alloc < t->prop_count + piece->prop_count ) {
+        _p = (struct hcml_cprop_t *)__hcml_realloc(t->props, 
+            (t->prop_count + piece->prop_count) * sizeof(struct hcml_cprop_t));
+        if ( _p == NULL ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Node Table");
+            return HCML_NODE_NONE;
+        }
+        t->props = _p;
+        t->prop_alloc = t->prop_count + piece->prop_count;
+    }
+    memcpy(t->props + _pbase, piece->props, piece->prop_count * sizeof(struct hcml_cprop_t));
+    t->prop_count += piece->prop_count;
+    _n = t->nodes + _base;
+    memcpy(_n, piece->nodes, piece->node_count * sizeof(struct hcml_cnode_t));
+    for ( _i = 0; _i < piece->node_count; ++_i, ++_n ) {
+        if ( _n->parent != HCML_NODE_NONE ) _n->parent += _base;
+        if ( _n->child != HCML_NODE_NONE ) _n->child += _base;
+        if ( _n->next != HCML_NODE_NONE ) _n->next += _base;
+        if ( _n->prop != HCML_NODE_NONE ) _n->prop += _pbase;
+    }
+    t->node_count += piece->node_count;
+    return root + _base;
 }
 
-/*
-    Get the last error code
+/* 
+    Split the source at the top-level tags and parse the pieces in parallel,
+    the top-level nodes are linked as siblings. The table and the error are 
+    the same as __parse_hcml_tree__
  */
-int hcml_get_errcode( hcml_t h ) {
-    return ((hcml_node_t *)h)->errcode;
-}
+struct hcml_node_table_t * __parse_hcml_tree_parallel__( 
+    hcml_node_t *h, const char *rbuf, int rbufl, uint32_t *root 
+) {
+    struct __parse_pool_t _pool;
+    struct hcml_node_table_t *_t;
+    uint32_t _tail = HCML_NODE_NONE, _first;
+    int _threads, _target, _i, _err = -1;
+#ifndef __IS_WINDOWS__
+    pthread_t *_tids;
+    int _started = 0;
+#endif
 
-/*
-    Set error code and message
- */
-void hcml_set_error( hcml_t h, int code, const char * msgfmt, ... ) {
-    int _ml;
-    hcml_node_t *_h;
-    va_list _arglist;
-    if ( h == 0 ) return;
-    _h = (hcml_node_t *)h;
-    va_start( _arglist, msgfmt );
-#ifdef __IS_WINDOWS__
-    _ml = vsprintf_s( _h->errmsg, 255, msgfmt, _arglist );
+    *root = HCML_NODE_NONE;
+    _threads = h->parse_threads;
+#ifndef __IS_WINDOWS__
+    if ( _threads < 0 ) _threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
 #else
-    _ml = vsnprintf( _h->errmsg, 255, msgfmt, _arglist );
+    _threads = 1;
 #endif
-    va_end( _arglist );
-    _h->errmsg[_ml] = 0;
-    _h->errcode = code;
+    memset(&_pool, 0, sizeof(_pool));
+    if ( _threads > 1 && rbufl >= __PARSE_PIECE_MIN_SIZE__ * 2 ) {
+        /* Several pieces for every thread to balance the load */
+        _target = rbufl / (_threads * 4);
+        if ( _target < __PARSE_PIECE_MIN_SIZE__ ) _target = __PARSE_PIECE_MIN_SIZE__;
+        _pool.count = __split_hcml_source__(h, rbuf, rbufl, _target, &_pool.pieces);
+        for ( _i = 0; _i < _pool.count; ++_i ) {
+            _pool.pieces[_i].table = __new_node_table(rbuf);
+            if ( _pool.pieces[_i].table == NULL ) break;
+        }
+        if ( _i < _pool.count ) {
+            while ( _i > 0 ) __free_node_table(_pool.pieces[--_i].table);
+            _pool.count = 0;
+        }
+    }
+    if ( _pool.count <= 1 ) {
+        if ( _pool.count == 1 ) __free_node_table(_pool.pieces[0].table);
+        __hcml_free(_pool.pieces);
+        _t = __new_node_table(rbuf);
+        if ( _t == NULL ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Node Table");
+            return NULL;
+        }
+        *root = __parse_hcml_tree__(h, _t, rbuf, rbufl, 1);
+        __name_node_table(_t);
+        return _t;
+    }
+    if ( _threads > _pool.count ) _threads = _pool.count;
+
+#ifndef __IS_WINDOWS__
+    pthread_mutex_init(&_pool.lock, NULL);
+    _tids = (pthread_t *)__hcml_malloc(sizeof(pthread_t) * _threads);
+    if ( _tids != NULL ) {
+        for ( ; _started < _threads - 1; ++_started ) {
+            if ( 0 != pthread_create(_tids + _started, NULL, __parse_hcml_worker__, &_pool) ) break;
+        }
+    }
+    /* Current thread is also a worker */
+    __parse_hcml_worker__(&_pool);
+    for ( _i = 0; _i < _started; ++_i ) pthread_join(_tids[_i], NULL);
+    __hcml_free(_tids);
+    pthread_mutex_destroy(&_pool.lock);
+#endif
+
+    /* Merge the pieces until the first error, as the serial parser stops */
+    _t = _pool.pieces[0].table;
+    for ( _i = 0; _i < _pool.count; ++_i ) {
+        if ( _err < 0 ) {
+            if ( _pool.pieces[_i].root != HCML_NODE_NONE ) {
+                _first = _pool.pieces[_i].root;
+                if ( _i > 0 ) _first = __merge_node_table(h, _t, _pool.pieces[_i].table, _first);
+                if ( _first == HCML_NODE_NONE ) {
+                    _err = _i;
+                } else {
+                    if ( _tail == HCML_NODE_NONE ) *root = _first;
+                    else _t->nodes[_tail].next = _first;
+                    for ( _tail = _first; _t->nodes[_tail].next != HCML_NODE_NONE; 
+                        _tail = _t->nodes[_tail].next );
+                }
+            }
+            h->line = _pool.pieces[_i].node.line;
+            if ( _err < 0 && _pool.pieces[_i].node.errcode != HCML_ERR_OK ) {
+                _err = _i;
+                __set_error__(h, _pool.pieces[_i].node.errcode, "%s", _pool.pieces[_i].node.errmsg);
+            }
+        }
+        if ( _i > 0 ) __free_node_table(_pool.pieces[_i].table);
+    }
+    __hcml_free(_pool.pieces);
+    __name_node_table(_t);
+    return _t;
 }
 
 /* 
-    Get the output size 
+    Give every tag name an id in the name table, the tags beyond the name
+    table, or all tags when failed to alloc, are looked up by the name
  */
-int hcml_get_output_size( hcml_t h ) {
-    return ((hcml_node_t *)h)->rsize;
-}
+void __name_node_table( struct hcml_node_table_t *t ) {
+    struct hcml_cnode_t *_c;
+    uint32_t *_slots;
+    uint32_t _tags, _slot_size, _slot, _i, _j;
 
-/*
-    Set the static string print method
- */
-void hcml_set_print_method( hcml_t h, const char* method ) {
-    ((hcml_node_t *)h)->print_method_l = strlen(method);
-    if ( ((hcml_node_t *)h)->print_method_l > 127 ) {
-        ((hcml_node_t *)h)->print_method_l = 127;
+    for ( _tags = 0, _i = 0; _i < t->node_count; ++_i ) {
+        if ( t->nodes[_i].flags & HCML_CNODE_TAG ) ++_tags;
     }
-    strncpy(((hcml_node_t *)h)->print_method, method, 
-        ((hcml_node_t *)h)->print_method_l);
-    ((hcml_node_t *)h)->print_method[((hcml_node_t *)h)->print_method_l] = 0;
+    if ( _tags == 0 ) return;
+    /* Name slots, half empty at least */
+    _slot_size = 16;
+    while ( _slot_size < _tags * 2 ) _slot_size <<= 1;
+    _slots = (uint32_t *)__hcml_calloc(_slot_size, sizeof(uint32_t));
+    t->names = (struct hcml_cname_t *)__hcml_malloc(
+        (_tags < HCML_CNAME_NONE ? _tags : HCML_CNAME_NONE) * sizeof(struct hcml_cname_t));
+    if ( _slots == NULL || t->names == NULL ) {
+        __hcml_free(_slots);
+        __hcml_free(t->names);
+        t->names = NULL;
+        return;
+    }
+    for ( _i = 0; _i < t->node_count; ++_i ) {
+        _c = t->nodes + _i;
+        if ( !(_c->flags & HCML_CNODE_TAG) ) continue;
+        _slot = (uint32_t)__hash_fnv1a(t->source + _c->data_off, (int)_c->data_len) & (_slot_size - 1);
+        while ( _slots[_slot] != 0 ) {
+            _j = _slots[_slot] - 1;
+            if ( t->names[_j].len == _c->data_len && 
+                memcmp(t->source + t->names[_j].off, t->source + _c->data_off, _c->data_len) == 0 ) break;
+            _slot = (_slot + 1) & (_slot_size - 1);
+        }
+        if ( _slots[_slot] == 0 ) {
+            if ( t->name_count == HCML_CNAME_NONE ) continue;
+            t->names[t->name_count].off = _c->data_off;
+            t->names[t->name_count].len = _c->data_len;
+            _slots[_slot] = ++t->name_count;
+        }
+        _c->name_id = (uint16_t)(_slots[_slot] - 1);
+    }
+    __hcml_free(_slots);
 }
 
-/*
-    Get the static string print method
-*/
-const char* hcml_get_print_method( hcml_t h ) {
-    return ((hcml_node_t *)h)->print_method;
+/* Free the pointer tree view of the node table, the nodes have been changed */
+void __free_node_view( struct hcml_node_table_t *t ) {
+    __hcml_free(t->view);
+    __hcml_free(t->view_props);
+    t->view = NULL;
+    t->view_props = NULL;
 }
 
-/*
-    Set the language prefix, default is "cxx"
- */
+/* Build the pointer tree view of the node table, return 0 when failed to alloc */
+int __build_node_view( struct hcml_node_table_t *t ) {
+    struct hcml_cnode_t *_c;
+    struct hcml_cprop_t *_cp;
+    struct hcml_tag_t *_v;
+    struct hcml_prop_t *_vp;
+    uint32_t _i, _j;
 
-void hcml_set_lang_prefix( hcml_t h, const char * prefix ) {
-    ((hcml_node_t *)h)->lang_prefix_l = strlen(prefix);
-    if ( ((hcml_node_t *)h)->lang_prefix_l > 127 ) {
-        ((hcml_node_t *)h)->lang_prefix_l = 127;
+    t->view = (struct hcml_tag_t *)__hcml_malloc((t->node_count + 1) * sizeof(struct hcml_tag_t));
+    t->view_props = (struct hcml_prop_t *)__hcml_malloc((t->prop_count + 1) * sizeof(struct hcml_prop_t));
+    if ( t->view == NULL || t->view_props == NULL ) {
+        __free_node_view(t);
+        return 0;
     }
-    strncpy(((hcml_node_t *)h)->lang_prefix, prefix, 
-        ((hcml_node_t *)h)->lang_prefix_l);
-    ((hcml_node_t *)h)->lang_prefix[((hcml_node_t *)h)->lang_prefix_l] = 0;
-}
-/*
-    Get the language prefix
- */
-const char * hcml_get_lang_prefix( hcml_t h ) {
-    return ((hcml_node_t *)h)->lang_prefix;
-}
-
-/* Dump debug structure info */
-void hcml_dump_tag( struct hcml_tag_t * root, int lv ) {
-    struct hcml_prop_t * _p;
-    if ( root->is_tag == 1 ) {
-        printf("%*s<Tag>: %.*s", lv * 2, "", root->dl, root->data_string);
-        _p = root->p_root;
-        if ( root->p_root != NULL ) printf("(");
-        while ( _p != NULL ) {
-            printf("%.*s: %.*s", _p->kl, _p->key, _p->vl, _p->value);
-            if ( _p->n_prop != NULL ) {
-                printf(", ");
-            }
-            _p = _p->n_prop;
-        }
-        if ( root->p_root != NULL ) printf(")");
-        printf("\n");
-    } else {
-        if ( root->dl > 10 ) {
-            printf("%*s<String>: ", lv * 2, "");
-            __print_num_string( root->data_string, 6 );
-            printf("...");
-            __print_num_string( root->data_string + root->dl - 4, 4 );
+    for ( _i = 0; _i < t->prop_count; ++_i ) {
+        _cp = t->props + _i;
+        _vp = t->view_props + _i;
+        _vp->key = t->source + _cp->key_off;
+        _vp->kl = (int)_cp->key_len;
+        if ( _cp->value_off == HCML_NODE_NONE ) {
+            _vp->value = __value_true;
         } else {
-            printf("%*s<String>: ", lv * 2, "");
-            __print_num_string( root->data_string, root->dl );
+            _vp->value = t->source + _cp->value_off;
         }
-        printf("(%d)\n", root->dl);
-    }
-    if ( root->c_tag != NULL ) {
-        hcml_dump_tag(root->c_tag, lv + 1);
+        _vp->vl = (int)_cp->value_len;
+        _vp->n_prop = NULL;
     }
-    if ( root->n_tag != NULL ) {
-        hcml_dump_tag(root->n_tag, lv);
+    for ( _i = 0; _i < t->node_count; ++_i ) {
+        _c = t->nodes + _i;
+        _v = t->view + _i;
+        _v->is_tag = (_c->flags & HCML_CNODE_TAG) ? 1 : 0;
+        _v->is_ended = (_c->flags & HCML_CNODE_ENDED) ? 1 : 0;
+        _v->fold_data = (_c->flags & HCML_CNODE_FOLDED) ? t->fold[_i] : NULL;
+        _v->data_string = (_v->fold_data != NULL ? _v->fold_data : t->source + _c->data_off);
+        _v->dl = (int)_c->data_len;
+        _v->bline = (int)_c->bline;
+        _v->p_root = NULL;
+        if ( _c->prop_count > 0 ) {
+            _v->p_root = t->view_props + _c->prop;
+            for ( _j = 1; _j < _c->prop_count; ++_j ) {
+                t->view_props[_c->prop + _j - 1].n_prop = t->view_props + _c->prop + _j;
+            }
+        }
+        _v->c_tag = (_c->child != HCML_NODE_NONE) ? t->view + _c->child : NULL;
+        _v->n_tag = (_c->next != HCML_NODE_NONE) ? t->view + _c->next : NULL;
+        _v->f_tag = (_c->parent != HCML_NODE_NONE) ? t->view + _c->parent : NULL;
     }
+    return 1;
 }
-/*
-    Set and get the old language generator function point.
-    fp can be NULL
- */
-hcml_lang_generator hcml_set_lang_generator( hcml_t h, hcml_lang_generator fp ) {
-    void *_ofp;
-    if ( h == 0 ) return NULL;
-    _ofp = ((hcml_node_t *)h)->langfp;
-    if ( fp != NULL ) {
-        ((hcml_node_t *)h)->langfp = (void *)fp;
+
+/* Run of top-level statements generated by a thread */
+struct __generate_piece_t {
+    uint32_t                root;
+    /* First statement of the next piece, the piece stops before it */
+    uint32_t                next;
+    /* Private copy of the handler with its own output */
+    hcml_node_t             node;
+};
+struct __generate_pool_t {
+    struct __generate_piece_t   *pieces;
+    int                         count;
+    int                         next;
+#ifndef __IS_WINDOWS__
+    pthread_mutex_t             lock;
+#endif
+};
+
+/* Node count of the subtree */
+int __tag_node_count( const struct hcml_node_table_t *t, uint32_t node ) {
+    int _c = 1;
+    for ( node = t->nodes[node].child; node != HCML_NODE_NONE; node = t->nodes[node].next ) {
+        _c += __tag_node_count(t, node);
     }
-    return (hcml_lang_generator)_ofp;
+    return _c;
 }
-/*
-    Set and get the old extend language generator function point.
-    fp can be NULL
-*/
-hcml_lang_generator hcml_set_exlang_generator( hcml_t h, hcml_lang_generator fp ) {
-    void *_ofp;
-    if ( h == 0 ) return NULL;
-    _ofp = ((hcml_node_t *)h)->exlangfp;
-    if ( fp != NULL ) {
-        ((hcml_node_t *)h)->exlangfp = (void *)fp;
+
+/* Generating thread, take the next piece until all done */
+void * __generate_hcml_worker__( void *arg ) {
+    struct __generate_pool_t *_pool = (struct __generate_pool_t *)arg;
+    struct __generate_piece_t *_piece;
+    int _i;
+    while ( 1 ) {
+#ifndef __IS_WINDOWS__
+        pthread_mutex_lock(&_pool->lock);
+#endif
+        _i = _pool->next++;
+#ifndef __IS_WINDOWS__
+        pthread_mutex_unlock(&_pool->lock);
+#endif
+        if ( _i >= _pool->count ) break;
+        _piece = _pool->pieces + _i;
+        hcml_generate_cxx_nodes(&_piece->node, _piece->root, _piece->next, "\n");
     }
-    return (hcml_lang_generator)_ofp;
+    return NULL;
 }
 
+/* 
+    Split the top-level statements into runs of similar node count, generate
+    them by a pool of threads into their own buffers, and join the buffers
+    in order. The output and the error are the same as the serial generation.
+    Return 0 when the template must be generated serially
+ */
+int __generate_hcml_parallel__( hcml_node_t *h, uint32_t root ) {
+    struct __generate_pool_t _pool;
+    struct __generate_piece_t *_piece;
+    const struct hcml_node_table_t *_t = h->table;
+    uint32_t _node, _last;
+    int _threads, _total, _target, _weight, _i;
+#ifndef __IS_WINDOWS__
+    pthread_t *_tids;
+    int _started = 0;
+#endif
+
+    _threads = h->generate_threads;
+#ifndef __IS_WINDOWS__
+    if ( _threads < 0 ) _threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    _threads = 1;
+#endif
+    if ( _threads <= 1 || h->errcode != HCML_ERR_OK || 
+        root == HCML_NODE_NONE || _t->nodes[root].next == HCML_NODE_NONE 
+    ) {
+        return 0;
+    }
+    _total = 0;
+    for ( _node = root; _node != HCML_NODE_NONE; _node = _t->nodes[_node].next ) {
+        _total += __tag_node_count(_t, _node);
+    }
+    if ( _total < __GENERATE_PIECE_MIN_NODES__ * 2 ) return 0;
+    if ( !hcml_prepare_cxx_parallel(h, root) ) return 0;
 
-/* Append Data to node result */
-int hcml_append_code_data( hcml_node_t *h, const char *s, int l ) {
-    if ( l == 0 ) { return 1; }
-    while ( (h->bufsize - h->rsize) <= l ) {
-        h->presult = (char *)realloc(h->presult, h->bufsize * 2);
-        if ( h->presult == NULL ) {
-            hcml_set_error(h, HCML_ERR_ERBUFALLOC, 
-                "Malloc Error for Result Buffer");
-            return 0;
+    /* Several pieces for every thread to balance the load */
+    _target = _total / (_threads * 4);
+    if ( _target < __GENERATE_PIECE_MIN_NODES__ ) _target = __GENERATE_PIECE_MIN_NODES__;
+    memset(&_pool, 0, sizeof(_pool));
+    _pool.pieces = (struct __generate_piece_t *)__hcml_calloc(
+        _total / _target + 2, sizeof(struct __generate_piece_t));
+    if ( _pool.pieces == NULL ) return 0;
+    for ( _node = root; _node != HCML_NODE_NONE; ) {
+        _piece = _pool.pieces + _pool.count++;
+        _piece->root = _node;
+        _piece->next = HCML_NODE_NONE;
+        _weight = 0;
+        for ( _last = _node; _last != HCML_NODE_NONE; _last = _t->nodes[_last].next ) {
+            _weight += __tag_node_count(_t, _last);
+            if ( _weight >= _target ) break;
         }
-        h->bufsize *= 2;
+        if ( _last == HCML_NODE_NONE ) break;
+        _piece->next = _node = _t->nodes[_last].next;
     }
-    strncpy( h->presult + h->rsize, s, l );
-    h->rsize += l;
-    h->presult[h->rsize] = '\0';
+    if ( _pool.count <= 1 ) {
+        __hcml_free(_pool.pieces);
+        return 0;
+    }
+    for ( _i = 0; _i < _pool.count; ++_i ) {
+        _piece = _pool.pieces + _i;
+        memcpy(&_piece->node, h, sizeof(hcml_node_t));
+        _piece->node.is_worker = 1;
+        _piece->node.flush_lines = NULL;
+        _piece->node.flush_count = 0;
+        _piece->node.flush_bufsize = 0;
+        _piece->node.rsize = 0;
+        _piece->node.bufsize = 1024;
+        _piece->node.presult = (char *)__hcml_malloc(_piece->node.bufsize);
+        if ( _piece->node.presult == NULL ) break;
+        _piece->node.presult[0] = '\0';
+    }
+    if ( _i < _pool.count ) {
+        while ( _i > 0 ) __hcml_free(_pool.pieces[--_i].node.presult);
+        __hcml_free(_pool.pieces);
+        return 0;
+    }
+    if ( _threads > _pool.count ) _threads = _pool.count;
+
+#ifndef __IS_WINDOWS__
+    pthread_mutex_init(&_pool.lock, NULL);
+    _tids = (pthread_t *)__hcml_malloc(sizeof(pthread_t) * _threads);
+    if ( _tids != NULL ) {
+        for ( ; _started < _threads - 1; ++_started ) {
+            if ( 0 != pthread_create(_tids + _started, NULL, __generate_hcml_worker__, &_pool) ) break;
+        }
+    }
+    /* Current thread is also a worker */
+    __generate_hcml_worker__(&_pool);
+    for ( _i = 0; _i < _started; ++_i ) pthread_join(_tids[_i], NULL);
+    __hcml_free(_tids);
+    pthread_mutex_destroy(&_pool.lock);
+#endif
+
+    /* Join the output until the first error, as the serial generation stops */
+    for ( _i = 0; _i < _pool.count; ++_i ) {
+        _piece = _pool.pieces + _i;
+        if ( h->errcode == HCML_ERR_OK ) {
+            hcml_append_code_data(h, _piece->node.presult, _piece->node.rsize);
+            for ( _weight = 0; _weight < _piece->node.flush_count; ++_weight ) {
+                if ( h->errcode == HCML_ERR_OK ) {
+                    hcml_append_flush_point(h, _piece->node.flush_lines[_weight]);
+                }
+            }
+            if ( h->errcode == HCML_ERR_OK && _piece->node.errcode != HCML_ERR_OK ) {
+                __set_error__(h, _piece->node.errcode, "%s", _piece->node.errmsg);
+            }
+        }
+        __hcml_free(_piece->node.presult);
+        __hcml_free(_piece->node.flush_lines);
+    }
+    __hcml_free(_pool.pieces);
+    return 1;
+}
+
+/* 
+    Generate the code, top-level statements may be outlined by the C++ generator,
+    a generator plugin is given the pointer tree view of the nodes
+ */
+void __generate_hcml__( hcml_node_t *h, uint32_t root ) {
+    struct hcml_tag_t *_view;
+    int _lines = ( h->line_directives && h->langfp == (void *)&hcml_generate_cxx_lang );
+    if ( _lines && HCML_ERR_OK != hcml_prepare_cxx_lines(h) ) return;
+    if ( h->outline_size > 0 && !h->is_static && 
+        h->langfp == (void *)&hcml_generate_cxx_lang 
+    ) {
+        hcml_generate_cxx_outline(h, root, "\n");
+    } else if ( __generate_hcml_parallel__(h, root) ) {
+        /* Generated by the workers, every piece ends in the generated file */
+        h->line_in_template = 0;
+    } else if ( h->langfp == (void *)&hcml_generate_cxx_lang ) {
+        hcml_generate_cxx_nodes(h, root, HCML_NODE_NONE, "\n");
+    } else if ( h->langfp != NULL ) {
+        _view = hcml_get_node_view(h, (int)root);
+        if ( _view != NULL ) (*(hcml_lang_generator)(h->langfp))(h, _view, "\n");
+    }
+    /* The directives back to the generated file are numbered at last */
+    if ( _lines && h->errcode == HCML_ERR_OK ) hcml_sync_cxx_lines(h);
+}
+
+/* Parse the code and generate */
+void __parse_hcml__( hcml_node_t *h, const char *rbuf, int rbufl ) {
+    uint32_t __root_node;
+
+    h->table = __parse_hcml_tree_parallel__(h, rbuf, rbufl, &__root_node);
+    if ( h->table == NULL ) return;
+    if ( __root_node != HCML_NODE_NONE ) {
+#ifdef DUMP_AFTER_PARSE
+        if ( hcml_get_node_view(h, (int)__root_node) != NULL ) {
+            hcml_dump_tag( hcml_get_node_view(h, (int)__root_node), 0 );
+        }
+#endif
+        if ( h->const_folding && h->errcode == HCML_ERR_OK && 
+            h->langfp == (void *)&hcml_generate_cxx_lang 
+        ) {
+            if ( HCML_ERR_OK == hcml_fold_cxx_lang(h, &__root_node) ) {
+                /* Whole template folded to nothing */
+                if ( __root_node != HCML_NODE_NONE ) __generate_hcml__(h, __root_node);
+            }
+        } else {
+            __generate_hcml__(h, __root_node);
+        }
+    }
+    __free_node_table( h->table );
+    h->table = NULL;
+}
+
+/* 64bit FNV-1a hash of the data */
+unsigned long long __hash_fnv1a( const char *s, int l ) {
+    unsigned long long _h = 14695981039346656037ULL;
+    int _i;
+    for ( _i = 0; _i < l; ++_i ) {
+        _h ^= (unsigned char)s[_i];
+        _h *= 1099511628211ULL;
+    }
+    return _h;
+}
+
+/* Read the whole file into a new allocated buffer, return the size or -1 */
+int __read_source_file( hcml_node_t *h, const char *path, char **buf ) {
+    int __fdsrc, __fsize;
+    struct stat __fstat;
+
+    *buf = NULL;
+    __fsize = -1;
+    __fdsrc = open(path, O_RDONLY);
+    if ( __fdsrc == -1 ) {
+        __set_error__(h, HCML_ERR_ERRSRC, "Cannot open source file for reading");
+        return -1;
+    }
+    do {
+        if ( fstat(__fdsrc, &__fstat) != 0 ) {
+            __set_error__(h, HCML_ERR_ESTAT, "Stat source file error");
+            break;
+        }
+        *buf = (char *)__hcml_malloc(__fstat.st_size + 1);
+        if ( *buf == NULL ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Reading Buffer");
+            break;
+        }
+        /* Read the whole source code into memory */
+        __fsize = read( __fdsrc, *buf, __fstat.st_size );
+        if ( __fsize < 0 ) {
+            __set_error__(h, HCML_ERR_ERRSRC, "Cannot read source file");
+            __hcml_free(*buf);
+            *buf = NULL;
+        }
+    } while ( 0 );
+    close(__fdsrc);
+    return __fsize;
+}
+
+/* Free the included template cache */
+void __free_include( struct hcml_include_t *inc ) {
+    struct hcml_include_t *_n;
+    while ( inc != NULL ) {
+        _n = inc->n_inc;
+        __free_node_table(inc->table);
+        __hcml_free(inc->sbuf);
+        __hcml_free(inc->path);
+        __hcml_free(inc->name);
+        __hcml_free(inc);
+        inc = _n;
+    }
+}
+
+void __free_schemas( hcml_node_t *h ) {
+    struct hcml_schema_t *_n;
+    while ( h->schemas != NULL ) {
+        _n = h->schemas->n_schema;
+        __hcml_free(h->schemas);
+        h->schemas = _n;
+    }
+}
+
+/* Get the display name of the template being generated */
+const char * hcml_current_name( hcml_node_t *h ) {
+    if ( h->cur_inc != NULL ) return h->cur_inc->name;
+    return ( h->src_name == NULL ? "" : h->src_name );
+}
+
+/* Get the node table of the template being generated, NULL if not generating */
+const struct hcml_node_table_t * hcml_get_node_table( hcml_node_t *h ) {
+    if ( h->cur_inc != NULL ) return h->cur_inc->table;
+    return h->table;
+}
+
+/* Get the index of the node in the node table, -1 if the node is not in it */
+int hcml_get_node_index( hcml_node_t *h, const struct hcml_tag_t *tag ) {
+    const struct hcml_node_table_t *_t = hcml_get_node_table(h);
+    if ( _t == NULL || _t->view == NULL || tag == NULL || 
+        tag < _t->view || tag >= _t->view + _t->node_count 
+    ) {
+        return -1;
+    }
+    return (int)(tag - _t->view);
+}
+
+/* 
+    Get the pointer tree view of the node in the node table, the view is
+    built on the first use. NULL if the node is not in it or failed to alloc
+ */
+struct hcml_tag_t * hcml_get_node_view( hcml_node_t *h, int index ) {
+    struct hcml_node_table_t *_t = (struct hcml_node_table_t *)hcml_get_node_table(h);
+    if ( _t == NULL || index < 0 || (uint32_t)index >= _t->node_count ) return NULL;
+    if ( _t->view == NULL && !__build_node_view(_t) ) {
+        __set_error__(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Node View");
+        return NULL;
+    }
+    return _t->view + index;
+}
+
+/* Record the include used by current parse */
+struct hcml_include_t * __use_include( hcml_node_t *h, struct hcml_include_t *inc ) {
+    struct hcml_include_t **_used;
+    int _i;
+    for ( _i = 0; _i < h->inc_used_count; ++_i ) {
+        if ( h->inc_used[_i] == inc ) return inc;
+    }
+    if ( h->inc_used_count == h->inc_used_bufsize ) {
+        _used = (struct hcml_include_t **)__hcml_realloc(h->inc_used, sizeof(struct hcml_include_t *) * 
+            (h->inc_used_bufsize == 0 ? 8 : h->inc_used_bufsize * 2));
+        if ( _used == NULL ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Include Cache");
+            return NULL;
+        }
+        h->inc_used = _used;
+        h->inc_used_bufsize = (h->inc_used_bufsize == 0 ? 8 : h->inc_used_bufsize * 2);
+    }
+    h->inc_used[h->inc_used_count++] = inc;
+    return inc;
+}
+
+/*
+    Get the included templates used by last parse, nested ones included
+ */
+int hcml_get_include_count( hcml_t h ) {
+    return ((hcml_node_t *)h)->inc_used_count;
+}
+
+/*
+    Get the real path of the used include
+ */
+const char * hcml_get_include_path( hcml_t h, int index ) {
+    if ( index < 0 || index >= ((hcml_node_t *)h)->inc_used_count ) return NULL;
+    return ((hcml_node_t *)h)->inc_used[index]->path;
+}
+
+/*
+    Get the name of last parsed template, relative to the working directory 
+    like the includes, used in the generated code and the header comment
+ */
+const char * hcml_get_source_name( hcml_t h ) {
+    const char *_name = ((hcml_node_t *)h)->src_name;
+    return ( _name == NULL ? "" : _name );
+}
+
+/* 
+    Display name of a resolved template path, relative to the current 
+    working directory when it is under it, NULL when malloc failed
+ */
+static char * __template_name( const char *real ) {
+    char _cwd[PATH_MAX];
+    int _dl = 0;
+    if ( getcwd(_cwd, sizeof(_cwd)) != NULL ) {
+        _dl = strlen(_cwd);
+        if ( strncmp(real, _cwd, _dl) != 0 || real[_dl] != '/' ) _dl = 0;
+        else ++_dl;
+    }
+    return __hcml_strdup(real + _dl);
+}
+
+/* 
+    Load the included template relative to the current template, 
+    cached on the handler, return NULL when error
+ */
+struct hcml_include_t * hcml_load_include( hcml_node_t *h, const char *src, int sl, int line ) {
+    char _path[PATH_MAX], _real[PATH_MAX], _msg[256];
+    const char *_dir_end, *_cur_path;
+    int _dl, _size, _line;
+    struct hcml_include_t *_inc;
+
+    /* Resolve the path relative to the current template */
+    _dl = 0;
+    _cur_path = ( h->cur_inc != NULL ? h->cur_inc->path : h->src_path );
+    if ( sl > 0 && src[0] != '/' && _cur_path != NULL ) {
+        _dir_end = strrchr(_cur_path, '/');
+        if ( _dir_end != NULL ) _dl = (int)(_dir_end - _cur_path) + 1;
+    }
+    if ( sl == 0 || (_dl + sl) >= PATH_MAX ) {
+        __set_error__(h, HCML_ERR_EINCLUDE, 
+            "Include Error: invalidate src at line: %d", line);
+        return NULL;
+    }
+    memcpy(_path, _cur_path, _dl);
+    memcpy(_path + _dl, src, sl);
+    _path[_dl + sl] = '\0';
+    if ( realpath(_path, _real) == NULL ) {
+        __set_error__(h, HCML_ERR_EINCLUDE, 
+            "Include Error: cannot open %s at line: %d", _path, line);
+        return NULL;
+    }
+    if ( h->src_path != NULL && strcmp(h->src_path, _real) == 0 ) {
+        __set_error__(h, HCML_ERR_EINCLUDE, 
+            "Include Error: include cycle of %s at line: %d", _path, line);
+        return NULL;
+    }
+
+    for ( _inc = h->inc_cache; _inc != NULL; _inc = _inc->n_inc ) {
+        if ( strcmp(_inc->path, _real) != 0 ) continue;
+        if ( _inc->busy && !h->is_worker ) {
+            __set_error__(h, HCML_ERR_EINCLUDE, 
+                "Include Error: include cycle of %s at line: %d", _path, line);
+            return NULL;
+        }
+        return __use_include(h, _inc);
+    }
+
+    /* Not in cache, read and parse it */
+    _inc = (struct hcml_include_t *)__hcml_calloc(1, sizeof(struct hcml_include_t));
+    if ( _inc == NULL ) {
+        __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Include Cache");
+        return NULL;
+    }
+    _inc->path = __hcml_strdup(_real);
+    /* Same name whoever includes it first */
+    _inc->name = __template_name(_real);
+    _size = __read_source_file(h, _real, &_inc->sbuf);
+    if ( _inc->path == NULL || _inc->name == NULL || _size < 0 ) {
+        if ( h->errcode == HCML_ERR_OK ) {
+            __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Include Cache");
+        }
+        __free_include(_inc);
+        return NULL;
+    }
+    _inc->table = __new_node_table(_inc->sbuf);
+    if ( _inc->table == NULL ) {
+        __set_error__(h, HCML_ERR_ESBUFALLOC, "Malloc Error for Include Cache");
+        __free_include(_inc);
+        return NULL;
+    }
+    _line = h->line;
+    _inc->root = __parse_hcml_tree__(h, _inc->table, _inc->sbuf, _size, 1);
+    __name_node_table(_inc->table);
+    h->line = _line;
+    if ( h->errcode != HCML_ERR_OK ) {
+        strncpy(_msg, h->errmsg, sizeof(_msg) - 1);
+        _msg[sizeof(_msg) - 1] = '\0';
+        __set_error__(h, h->errcode, "%s, in %s included at line: %d", _msg, _path, line);
+        __free_include(_inc);
+        return NULL;
+    }
+    _inc->n_inc = h->inc_cache;
+    h->inc_cache = _inc;
+    return __use_include(h, _inc);
+}
+
+/*
+    Clear the included template cache
+ */
+void hcml_clear_include_cache( hcml_t h ) {
+    hcml_node_t * _h = (hcml_node_t *)h;
+    if ( h == NULL ) return;
+    __free_include(_h->inc_cache);
+    _h->inc_cache = NULL;
+    _h->inc_used_count = 0;
+}
+
+/* 
+    Create an hcml handler 
+ */
+hcml_t hcml_create() {
+    hcml_node_t * _h;
+    _h = (hcml_node_t *)__hcml_calloc(1, sizeof(hcml_node_t));
+    if ( _h == NULL ) return NULL;
+    /* Deefault is CXX */
+    strcpy(_h->lang_prefix, "cxx");
+    _h->lang_prefix_l = 3;
+    _h->langfp = (void *)&hcml_generate_cxx_lang;
+    _h->exlangfp = NULL;
+    return (hcml_t)_h;
+}
+
+/* Free all registered tags */
+void __free_tag_entries( hcml_node_t *h ) {
+    struct hcml_tag_entry_t *_e, *_n;
+    int _i;
+    for ( _i = 0; _i < h->tag_bucket_size; ++_i ) {
+        for ( _e = h->tag_buckets[_i]; _e != NULL; _e = _n ) {
+            _n = _e->n_entry;
+            __hcml_free(_e->name);
+            __hcml_free(_e);
+        }
+    }
+    __hcml_free(h->tag_buckets);
+    h->tag_buckets = NULL;
+    h->tag_bucket_size = 0;
+    h->tag_count = 0;
+}
+
+/* 
+    Destroy an hcml handler and release all dynamic data 
+ */
+void hcml_destroy( hcml_t h ) {
+    hcml_node_t * _h = (hcml_node_t *)h;
+    int _i;
+    if ( h == NULL ) return;
+    if ( _h->presult != NULL ) {
+        __hcml_free(_h->presult);
+        _h->presult = NULL;
+    }
+    if ( _h->flush_lines != NULL ) {
+        __hcml_free(_h->flush_lines);
+        _h->flush_lines = NULL;
+    }
+    if ( _h->src_path != NULL ) {
+        __hcml_free(_h->src_path);
+        _h->src_path = NULL;
+    }
+    if ( _h->src_name != NULL ) {
+        __hcml_free(_h->src_name);
+        _h->src_name = NULL;
+    }
+    __free_include(_h->inc_cache);
+    _h->inc_cache = NULL;
+    __hcml_free(_h->inc_used);
+    _h->inc_used = NULL;
+    __free_tag_entries(_h);
+    for ( _i = 0; _i < _h->outline_alloc; ++_i ) __hcml_free(_h->outlines[_i].code);
+    __hcml_free(_h->outlines);
+    __hcml_free(_h->outline_params);
+    __hcml_free(_h->outline_args);
+    __hcml_free(_h->line_output);
+    __hcml_free(_h->line_return);
+    __free_schemas(_h);
+    _h->bufsize = 0;
+    _h->rsize = 0;
+    __hcml_free(_h);
+}
+
+/* 
+    Get the output buffer 
+ */
+const char * hcml_get_output( hcml_t h ) {
+    return ((hcml_node_t *)h)->presult;
+}
+
+/*
+    Get the last error message 
+ */
+const char * hcml_get_errstr( hcml_t h ) {
+    return ((hcml_node_t *)h)->errmsg;
+}
+
+/*
+    Get the last error code
+ */
+int hcml_get_errcode( hcml_t h ) {
+    return ((hcml_node_t *)h)->errcode;
+}
+
+/*
+    Set error code and message
+ */
+void hcml_set_error( hcml_t h, int code, const char * msgfmt, ... ) {
+    int _ml;
+    hcml_node_t *_h;
+    va_list _arglist;
+    if ( h == 0 ) return;
+    _h = (hcml_node_t *)h;
+    va_start( _arglist, msgfmt );
+#ifdef __IS_WINDOWS__
+    _ml = vsprintf_s( _h->errmsg, 255, msgfmt, _arglist );
+#else
+    _ml = vsnprintf( _h->errmsg, 255, msgfmt, _arglist );
+#endif
+    va_end( _arglist );
+    _h->errmsg[_ml] = 0;
+    _h->errcode = code;
+}
+
+/* 
+    Get the output size 
+ */
+int hcml_get_output_size( hcml_t h ) {
+    return ((hcml_node_t *)h)->rsize;
+}
+
+/*
+    Get the content hash of the output in hex, empty when last parse failed
+ */
+const char * hcml_get_output_hash( hcml_t h ) {
+    return ((hcml_node_t *)h)->output_hash;
+}
+
+/*
+    Set the static string print method
+ */
+void hcml_set_print_method( hcml_t h, const char* method ) {
+    ((hcml_node_t *)h)->print_method_l = strlen(method);
+    if ( ((hcml_node_t *)h)->print_method_l > 127 ) {
+        ((hcml_node_t *)h)->print_method_l = 127;
+    }
+    strncpy(((hcml_node_t *)h)->print_method, method, 
+        ((hcml_node_t *)h)->print_method_l);
+    ((hcml_node_t *)h)->print_method[((hcml_node_t *)h)->print_method_l] = 0;
+}
+
+/*
+    Get the static string print method
+*/
+const char* hcml_get_print_method( hcml_t h ) {
+    return ((hcml_node_t *)h)->print_method;
+}
+
+/*
+    Set the flush method, invoked by cxx:flush and auto flush points
+ */
+void hcml_set_flush_method( hcml_t h, const char* method ) {
+    ((hcml_node_t *)h)->flush_method_l = strlen(method);
+    if ( ((hcml_node_t *)h)->flush_method_l > 127 ) {
+        ((hcml_node_t *)h)->flush_method_l = 127;
+    }
+    strncpy(((hcml_node_t *)h)->flush_method, method, 
+        ((hcml_node_t *)h)->flush_method_l);
+    ((hcml_node_t *)h)->flush_method[((hcml_node_t *)h)->flush_method_l] = 0;
+}
+
+/*
+    Get the flush method
+ */
+const char * hcml_get_flush_method( hcml_t h ) {
+    return ((hcml_node_t *)h)->flush_method;
+}
+
+/*
+    Set the reserve method, invoked before cxx:each loop
+ */
+void hcml_set_reserve_method( hcml_t h, const char* method ) {
+    ((hcml_node_t *)h)->reserve_method_l = strlen(method);
+    if ( ((hcml_node_t *)h)->reserve_method_l > 127 ) {
+        ((hcml_node_t *)h)->reserve_method_l = 127;
+    }
+    strncpy(((hcml_node_t *)h)->reserve_method, method, 
+        ((hcml_node_t *)h)->reserve_method_l);
+    ((hcml_node_t *)h)->reserve_method[((hcml_node_t *)h)->reserve_method_l] = 0;
+}
+
+/*
+    Get the reserve method
+ */
+const char * hcml_get_reserve_method( hcml_t h ) {
+    return ((hcml_node_t *)h)->reserve_method;
+}
+
+/*
+    Set auto flush threshold, 0 to disable
+ */
+void hcml_set_auto_flush( hcml_t h, int bytes ) {
+    ((hcml_node_t *)h)->flush_threshold = (bytes < 0 ? 0 : bytes);
+}
+
+/*
+    Get auto flush threshold
+ */
+int hcml_get_auto_flush( hcml_t h ) {
+    return ((hcml_node_t *)h)->flush_threshold;
+}
+
+/*
+    Get the flush point count generated by last parse
+ */
+int hcml_get_flush_count( hcml_t h ) {
+    return ((hcml_node_t *)h)->flush_count;
+}
+
+/*
+    Get the template line of the flush point at index
+ */
+int hcml_get_flush_line( hcml_t h, int index ) {
+    if ( index < 0 || index >= ((hcml_node_t *)h)->flush_count ) return 0;
+    return ((hcml_node_t *)h)->flush_lines[index];
+}
+
+/*
+    Set the render mode, HCML_RENDER_PRINT, HCML_RENDER_COROUTINE or HCML_RENDER_RAWBUF
+ */
+void hcml_set_render_mode( hcml_t h, int mode ) {
+    ((hcml_node_t *)h)->render_mode = mode;
+}
+
+/*
+    Get the render mode
+ */
+int hcml_get_render_mode( hcml_t h ) {
+    return ((hcml_node_t *)h)->render_mode;
+}
+
+/*
+    Set the parsing threads, 0 or 1 to parse serially, negative to use all cores
+ */
+void hcml_set_parse_threads( hcml_t h, int threads ) {
+    ((hcml_node_t *)h)->parse_threads = threads;
+}
+
+/*
+    Get the parsing threads
+ */
+int hcml_get_parse_threads( hcml_t h ) {
+    return ((hcml_node_t *)h)->parse_threads;
+}
+
+/*
+    Set the generating threads, 0 or 1 to generate serially, negative to use all cores
+ */
+void hcml_set_generate_threads( hcml_t h, int threads ) {
+    ((hcml_node_t *)h)->generate_threads = threads;
+}
+
+/*
+    Get the generating threads
+ */
+int hcml_get_generate_threads( hcml_t h ) {
+    return ((hcml_node_t *)h)->generate_threads;
+}
+
+/*
+    Set the render probes level, default is HCML_PROBE_NONE
+ */
+void hcml_set_probes( hcml_t h, int level ) {
+    ((hcml_node_t *)h)->probes = level;
+}
+
+/*
+    Get the render probes level
+ */
+int hcml_get_probes( hcml_t h ) {
+    return ((hcml_node_t *)h)->probes;
+}
+
+/*
+    Enable or disable #line directives, default is 0
+ */
+void hcml_set_line_directives( hcml_t h, int enable ) {
+    ((hcml_node_t *)h)->line_directives = (enable ? 1 : 0);
+}
+
+/*
+    Get #line directives flag
+ */
+int hcml_get_line_directives( hcml_t h ) {
+    return ((hcml_node_t *)h)->line_directives;
+}
+
+/*
+    Set the name of the generated file, NULL to use the source with .inc
+ */
+void hcml_set_line_output( hcml_t h, const char *name ) {
+    hcml_node_t *_h = (hcml_node_t *)h;
+    __hcml_free(_h->line_output);
+    _h->line_output = (name != NULL && name[0] != '\0' ? __hcml_strdup(name) : NULL);
+}
+
+/*
+    Get the name of the generated file, NULL for the source with .inc
+ */
+const char * hcml_get_line_output( hcml_t h ) {
+    return ((hcml_node_t *)h)->line_output;
+}
+
+/*
+    Enable or disable constant folding, default is 0
+ */
+void hcml_set_const_folding( hcml_t h, int enable ) {
+    ((hcml_node_t *)h)->const_folding = (enable ? 1 : 0);
+}
+
+/*
+    Get constant folding flag
+ */
+int hcml_get_const_folding( hcml_t h ) {
+    return ((hcml_node_t *)h)->const_folding;
+}
+
+/*
+    Check if the whole template of last parse is static string
+ */
+int hcml_is_static( hcml_t h ) {
+    return ((hcml_node_t *)h)->is_static;
+}
+
+/*
+    Get the static output size of last parse when the template is static
+ */
+int hcml_get_static_size( hcml_t h ) {
+    return ((hcml_node_t *)h)->static_size;
+}
+
+/*
+    Get the ETag of the static output of last parse, empty when not static
+ */
+const char * hcml_get_static_etag( hcml_t h ) {
+    return ((hcml_node_t *)h)->static_etag;
+}
+
+/*
+    Set the static method, invoked with the precompressed static template
+ */
+void hcml_set_static_method( hcml_t h, const char* method ) {
+    ((hcml_node_t *)h)->static_method_l = strlen(method);
+    if ( ((hcml_node_t *)h)->static_method_l > 127 ) {
+        ((hcml_node_t *)h)->static_method_l = 127;
+    }
+    strncpy(((hcml_node_t *)h)->static_method, method, 
+        ((hcml_node_t *)h)->static_method_l);
+    ((hcml_node_t *)h)->static_method[((hcml_node_t *)h)->static_method_l] = 0;
+}
+
+/*
+    Get the static method
+ */
+const char * hcml_get_static_method( hcml_t h ) {
+    return ((hcml_node_t *)h)->static_method;
+}
+
+/*
+    Set the key type, empty to disable
+ */
+void hcml_set_key_type( hcml_t h, const char* type ) {
+    ((hcml_node_t *)h)->key_type_l = strlen(type);
+    if ( ((hcml_node_t *)h)->key_type_l > 127 ) {
+        ((hcml_node_t *)h)->key_type_l = 127;
+    }
+    strncpy(((hcml_node_t *)h)->key_type, type, 
+        ((hcml_node_t *)h)->key_type_l);
+    ((hcml_node_t *)h)->key_type[((hcml_node_t *)h)->key_type_l] = 0;
+}
+
+/*
+    Get the key type
+ */
+const char * hcml_get_key_type( hcml_t h ) {
+    return ((hcml_node_t *)h)->key_type;
+}
+
+/*
+    Set the hash function of the constant key, NULL for FNV-1a
+ */
+void hcml_set_key_hash( hcml_t h, hcml_key_hash fn ) {
+    ((hcml_node_t *)h)->key_hash = fn;
+}
+
+/*
+    Get the hash function of the constant key
+ */
+hcml_key_hash hcml_get_key_hash( hcml_t h ) {
+    return ((hcml_node_t *)h)->key_hash;
+}
+
+/* 
+    Names of the parameters as the arguments, the last identifier of each 
+    parameter without the default value, like "node, resp" for 
+    "const page_data& node, std::ostream &resp = std::cout"
+ */
+char *__outline_args( const char *params ) {
+    char *_args;
+    int _l, _i, _b, _e, _depth, _w;
+    _l = (int)strlen(params);
+    _args = (char *)__hcml_malloc(_l + 1);
+    if ( _args == NULL ) return NULL;
+    _w = 0;
+    _b = 0;
+    while ( _b < _l ) {
+        /* End of the parameter and the begin of the default value */
+        _depth = 0;
+        _e = -1;
+        for ( _i = _b; _i < _l; ++_i ) {
+            if ( params[_i] == '<' || params[_i] == '(' || params[_i] == '[' || params[_i] == '{' ) ++_depth;
+            else if ( params[_i] == '>' || params[_i] == ')' || params[_i] == ']' || params[_i] == '}' ) --_depth;
+            else if ( _depth == 0 && params[_i] == '=' && _e < 0 ) _e = _i;
+            else if ( _depth == 0 && params[_i] == ',' ) break;
+        }
+        if ( _e < 0 ) _e = _i;
+        _b = _i + 1;
+        /* Skip the spaces and the array bounds */
+        while ( _e > 0 ) {
+            if ( isspace((unsigned char)params[_e - 1]) ) {
+                --_e;
+            } else if ( params[_e - 1] == ']' ) {
+                while ( _e > 0 && params[_e - 1] != '[' ) --_e;
+                if ( _e > 0 ) --_e;
+            } else break;
+        }
+        for ( _i = _e; _i > 0 && (isalnum((unsigned char)params[_i - 1]) || params[_i - 1] == '_'); --_i );
+        if ( _i == _e ) continue;
+        if ( _w > 0 ) {
+            _args[_w++] = ',';
+            _args[_w++] = ' ';
+        }
+        memcpy(_args + _w, params + _i, _e - _i);
+        _w += _e - _i;
+    }
+    _args[_w] = '\0';
+    return _args;
+}
+
+/*
+    Set the outline size and the parameters of the outlined functions
+ */
+void hcml_set_outline( hcml_t h, int size, const char *params ) {
+    hcml_node_t * _h = (hcml_node_t *)h;
+    _h->outline_size = ( size > 0 ? size : 0 );
+    __hcml_free(_h->outline_params);
+    __hcml_free(_h->outline_args);
+    _h->outline_params = __hcml_strdup(params != NULL && params[0] != '\0' ? 
+        params : "std::ostream &resp");
+    _h->outline_args = __outline_args(_h->outline_params);
+}
+
+/*
+    Get the outline size
+ */
+int hcml_get_outline_size( hcml_t h ) {
+    return ((hcml_node_t *)h)->outline_size;
+}
+
+/*
+    Get the parameters of the outlined functions
+ */
+const char * hcml_get_outline_params( hcml_t h ) {
+    return ((hcml_node_t *)h)->outline_params;
+}
+
+/*
+    Set the shards of the outlined functions, 0 to make them static
+ */
+void hcml_set_outline_shards( hcml_t h, int shards ) {
+    ((hcml_node_t *)h)->outline_shards = ( shards > 0 ? shards : 0 );
+}
+
+/*
+    Get the shards of the outlined functions
+ */
+int hcml_get_outline_shards( hcml_t h ) {
+    return ((hcml_node_t *)h)->outline_shards;
+}
+
+/*
+    Get the outlined function count of last parse
+ */
+int hcml_get_outline_count( hcml_t h ) {
+    return ((hcml_node_t *)h)->outline_count;
+}
+
+/*
+    Get the code of the outlined functions in the shard
+ */
+const char * hcml_get_outline_code( hcml_t h, int shard, int *size ) {
+    hcml_node_t * _h = (hcml_node_t *)h;
+    if ( _h->outline_count == 0 || shard < 0 || shard >= _h->outline_alloc || 
+        shard >= (_h->outline_shards > 0 ? _h->outline_shards : 1) 
+    ) {
+        if ( size != NULL ) *size = 0;
+        return NULL;
+    }
+    if ( size != NULL ) *size = _h->outlines[shard].size;
+    return _h->outlines[shard].code;
+}
+
+/*
+    Set the language prefix, default is "cxx"
+ */
+
+void hcml_set_lang_prefix( hcml_t h, const char * prefix ) {
+    ((hcml_node_t *)h)->lang_prefix_l = strlen(prefix);
+    if ( ((hcml_node_t *)h)->lang_prefix_l > 127 ) {
+        ((hcml_node_t *)h)->lang_prefix_l = 127;
+    }
+    strncpy(((hcml_node_t *)h)->lang_prefix, prefix, 
+        ((hcml_node_t *)h)->lang_prefix_l);
+    ((hcml_node_t *)h)->lang_prefix[((hcml_node_t *)h)->lang_prefix_l] = 0;
+}
+/*
+    Get the language prefix
+ */
+const char * hcml_get_lang_prefix( hcml_t h ) {
+    return ((hcml_node_t *)h)->lang_prefix;
+}
+
+/* Dump debug structure info */
+void hcml_dump_tag( struct hcml_tag_t * root, int lv ) {
+    struct hcml_prop_t * _p;
+    if ( root->is_tag == 1 ) {
+        printf("%*s<Tag>: %.*s", lv * 2, "", root->dl, root->data_string);
+        _p = root->p_root;
+        if ( root->p_root != NULL ) printf("(");
+        while ( _p != NULL ) {
+            printf("%.*s: %.*s", _p->kl, _p->key, _p->vl, _p->value);
+            if ( _p->n_prop != NULL ) {
+                printf(", ");
+            }
+            _p = _p->n_prop;
+        }
+        if ( root->p_root != NULL ) printf(")");
+        printf("\n");
+    } else {
+        if ( root->dl > 10 ) {
+            printf("%*s<String>: ", lv * 2, "");
+            __print_num_string( root->data_string, 6 );
+            printf("...");
+            __print_num_string( root->data_string + root->dl - 4, 4 );
+        } else {
+            printf("%*s<String>: ", lv * 2, "");
+            __print_num_string( root->data_string, root->dl );
+        }
+        printf("(%d)\n", root->dl);
+    }
+    if ( root->c_tag != NULL ) {
+        hcml_dump_tag(root->c_tag, lv + 1);
+    }
+    if ( root->n_tag != NULL ) {
+        hcml_dump_tag(root->n_tag, lv);
+    }
+}
+/*
+    Set and get the old language generator function point.
+    fp can be NULL
+ */
+hcml_lang_generator hcml_set_lang_generator( hcml_t h, hcml_lang_generator fp ) {
+    void *_ofp;
+    if ( h == 0 ) return NULL;
+    _ofp = ((hcml_node_t *)h)->langfp;
+    if ( fp != NULL ) {
+        ((hcml_node_t *)h)->langfp = (void *)fp;
+    }
+    return (hcml_lang_generator)_ofp;
+}
+/*
+    Set and get the old user data of the language generator.
+    userdata can be NULL
+ */
+void * hcml_set_lang_userdata( hcml_t h, void *userdata ) {
+    void *_oud;
+    if ( h == 0 ) return NULL;
+    _oud = ((hcml_node_t *)h)->lang_userdata;
+    ((hcml_node_t *)h)->lang_userdata = userdata;
+    return _oud;
+}
+
+/*
+    Get the user data of the language generator
+ */
+void * hcml_get_lang_userdata( hcml_t h ) {
+    if ( h == 0 ) return NULL;
+    return ((hcml_node_t *)h)->lang_userdata;
+}
+
+/*
+    Set and get the old extend language generator function point.
+    fp can be NULL
+*/
+hcml_lang_generator hcml_set_exlang_generator( hcml_t h, hcml_lang_generator fp ) {
+    void *_ofp;
+    if ( h == 0 ) return NULL;
+    _ofp = ((hcml_node_t *)h)->exlangfp;
+    if ( fp != NULL ) {
+        ((hcml_node_t *)h)->exlangfp = (void *)fp;
+    }
+    return (hcml_lang_generator)_ofp;
+}
+
+/* Find the registered tag by name */
+struct hcml_tag_entry_t * __lookup_tag_entry( hcml_node_t *h, const char *name, int nl ) {
+    struct hcml_tag_entry_t *_e;
+    if ( h->tag_count == 0 ) return NULL;
+    _e = h->tag_buckets[__hash_fnv1a(name, nl) & (h->tag_bucket_size - 1)];
+    for ( ; _e != NULL; _e = _e->n_entry ) {
+        if ( _e->nl == nl && memcmp(_e->name, name, nl) == 0 ) return _e;
+    }
+    return NULL;
+}
+
+/* Double the buckets when the registry is full */
+int __grow_tag_buckets( hcml_node_t *h ) {
+    struct hcml_tag_entry_t **_b, *_e, *_n;
+    int _size, _i;
+    _size = ( h->tag_bucket_size == 0 ? 16 : h->tag_bucket_size * 2 );
+    _b = (struct hcml_tag_entry_t **)__hcml_calloc(_size, sizeof(struct hcml_tag_entry_t *));
+    if ( _b == NULL ) return -1;
+    for ( _i = 0; _i < h->tag_bucket_size; ++_i ) {
+        for ( _e = h->tag_buckets[_i]; _e != NULL; _e = _n ) {
+            _n = _e->n_entry;
+            _e->n_entry = _b[_e->hash & (_size - 1)];
+            _b[_e->hash & (_size - 1)] = _e;
+        }
+    }
+    __hcml_free(h->tag_buckets);
+    h->tag_buckets = _b;
+    h->tag_bucket_size = _size;
+    return 0;
+}
+
+/*
+    Register the generator of a tag, the name is after the language prefix.
+    A registered tag takes precedence over the built-in tag of the same name,
+    the user data is passed to the generator. fn can be NULL to unregister
+ */
+int hcml_register_tag( hcml_t h, const char *name, hcml_tag_generator fn, void *userdata ) {
+    hcml_node_t *_h = (hcml_node_t *)h;
+    struct hcml_tag_entry_t *_e, **_pe;
+    int _nl;
+    if ( _h == NULL ) return HCML_ERR_INVALIDATE_HANDLER;
+    if ( name == NULL || name[0] == '\0' ) {
+        __set_error__(_h, HCML_ERR_ESYNTAX, "Invalidate Tag Name");
+        return _h->errcode;
+    }
+    _nl = (int)strlen(name);
+    _e = __lookup_tag_entry(_h, name, _nl);
+    ++_h->tag_serial;
+    if ( fn == NULL ) {
+        if ( _e == NULL ) return HCML_ERR_OK;
+        _pe = &_h->tag_buckets[_e->hash & (_h->tag_bucket_size - 1)];
+        while ( *_pe != _e ) _pe = &(*_pe)->n_entry;
+        *_pe = _e->n_entry;
+        __hcml_free(_e->name);
+        __hcml_free(_e);
+        --_h->tag_count;
+        return HCML_ERR_OK;
+    }
+    if ( _e == NULL ) {
+        if ( _h->tag_count >= _h->tag_bucket_size && __grow_tag_buckets(_h) != 0 ) {
+            __set_error__(_h, HCML_ERR_ERBUFALLOC, "Malloc Error for Tag Registry");
+            return _h->errcode;
+        }
+        _e = (struct hcml_tag_entry_t *)__hcml_calloc(1, sizeof(struct hcml_tag_entry_t));
+        if ( _e != NULL ) _e->name = __hcml_strdup(name);
+        if ( _e == NULL || _e->name == NULL ) {
+            __hcml_free(_e);
+            __set_error__(_h, HCML_ERR_ERBUFALLOC, "Malloc Error for Tag Registry");
+            return _h->errcode;
+        }
+        _e->nl = _nl;
+        _e->hash = __hash_fnv1a(name, _nl);
+        _e->n_entry = _h->tag_buckets[_e->hash & (_h->tag_bucket_size - 1)];
+        _h->tag_buckets[_e->hash & (_h->tag_bucket_size - 1)] = _e;
+        ++_h->tag_count;
+    }
+    _e->fn = fn;
+    _e->userdata = userdata;
+    return HCML_ERR_OK;
+}
+
+/*
+    Copy all registered tags of src to dst
+ */
+int hcml_copy_tags( hcml_t dst, hcml_t src ) {
+    hcml_node_t *_s = (hcml_node_t *)src;
+    struct hcml_tag_entry_t *_e;
+    int _i;
+    if ( dst == NULL || _s == NULL ) return HCML_ERR_INVALIDATE_HANDLER;
+    for ( _i = 0; _i < _s->tag_bucket_size; ++_i ) {
+        for ( _e = _s->tag_buckets[_i]; _e != NULL; _e = _e->n_entry ) {
+            if ( HCML_ERR_OK != hcml_register_tag(dst, _e->name, _e->fn, _e->userdata) ) 
+                return ((hcml_node_t *)dst)->errcode;
+        }
+    }
+    return HCML_ERR_OK;
+}
+
+/*
+    Find the registered tag of the node in the node table, NULL if not registered.
+    Nodes are resolved by the name id, every name is looked up once after the 
+    registry changed
+ */
+const struct hcml_tag_entry_t * __find_node_tag( 
+    hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node 
+) {
+    const struct hcml_cnode_t *_c = t->nodes + node;
+    uint32_t _i;
+    if ( h->tag_count == 0 || !(_c->flags & HCML_CNODE_TAG) ) return NULL;
+    if ( _c->flags & HCML_CNODE_FOLDED ) return __lookup_tag_entry(h, t->fold[node], (int)_c->data_len);
+    if ( _c->name_id == HCML_CNAME_NONE ) {
+        return __lookup_tag_entry(h, t->source + _c->data_off, (int)_c->data_len);
+    }
+    if ( t->tag_serial != h->tag_serial ) {
+        if ( t->name_tags == NULL ) {
+            t->name_tags = (const struct hcml_tag_entry_t **)__hcml_malloc(
+                (t->name_count + 1) * sizeof(struct hcml_tag_entry_t *));
+            if ( t->name_tags == NULL ) {
+                return __lookup_tag_entry(h, t->source + _c->data_off, (int)_c->data_len);
+            }
+        }
+        for ( _i = 0; _i < t->name_count; ++_i ) {
+            t->name_tags[_i] = __lookup_tag_entry(h, 
+                t->source + t->names[_i].off, (int)t->names[_i].len);
+        }
+        t->tag_serial = h->tag_serial;
+    }
+    return t->name_tags[_c->name_id];
+}
+
+/*
+    Find the registered tag of the node, NULL if not registered
+ */
+const struct hcml_tag_entry_t * hcml_find_tag( hcml_node_t *h, const struct hcml_tag_t *tag ) {
+    int _index;
+    if ( h->tag_count == 0 || tag == NULL || tag->is_tag == 0 ) return NULL;
+    _index = hcml_get_node_index(h, tag);
+    if ( _index < 0 ) return __lookup_tag_entry(h, tag->data_string, tag->dl);
+    return __find_node_tag(h, (struct hcml_node_table_t *)hcml_get_node_table(h), (uint32_t)_index);
+}
+
+/* Make room for l more bytes and the tail zero */
+int __reserve_result( hcml_node_t *h, int l ) {
+    char *_p;
+    while ( (h->bufsize - h->rsize) <= l ) {
+        _p = (char *)__hcml_realloc(h->presult, h->bufsize * 2);
+        if ( _p == NULL ) {
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, 
+                "Malloc Error for Result Buffer");
+            return 0;
+        }
+        h->presult = _p;
+        h->bufsize *= 2;
+    }
+    return 1;
+}
+
+/* Append Data to node result */
+int hcml_append_code_data( hcml_node_t *h, const char *s, int l ) {
+    if ( l == 0 ) { return 1; }
+    if ( !__reserve_result(h, l) ) return 0;
+    strncpy( h->presult + h->rsize, s, l );
+    h->rsize += l;
+    h->presult[h->rsize] = '\0';
+    return 1;
+}
+
+/* Record a flush point at the template line */
+int hcml_append_flush_point( hcml_node_t *h, int line ) {
+    int *_lines;
+    if ( h->flush_count == h->flush_bufsize ) {
+        _lines = (int *)__hcml_realloc(h->flush_lines, 
+            sizeof(int) * (h->flush_bufsize == 0 ? 16 : h->flush_bufsize * 2));
+        if ( _lines == NULL ) {
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, 
+                "Malloc Error for Flush Point Buffer");
+            return 0;
+        }
+        h->flush_lines = _lines;
+        h->flush_bufsize = (h->flush_bufsize == 0 ? 16 : h->flush_bufsize * 2);
+    }
+    h->flush_lines[h->flush_count++] = line;
+    h->flush_pending = 0;
     return 1;
 }
 
@@ -693,81 +2249,158 @@ int hcml_append_code_format( hcml_node_t *h, const char *fmt, ... ) {
     va_end( _arglist );
     if ( _append_len == 0 ) return 1;
     va_start( _arglist, fmt );
-    while ( (h->bufsize - h->rsize) <= _append_len ) {
-        h->presult = (char *)realloc(h->presult, h->bufsize * 2);
-        if ( h->presult == NULL ) {
-            hcml_set_error(h, HCML_ERR_ERBUFALLOC, 
-                "Malloc Error for Result Buffer");
-            return 0;
-        }
-        h->bufsize *= 2;
+    if ( !__reserve_result(h, _append_len) ) {
+        va_end( _arglist );
+        return 0;
     }
 #ifdef __IS_WINDOWS__
     _append_len = vsprintf_s( h->presult + h->rsize, h->bufsize - h->rsize, fmt, _arglist );
 #else
     _append_len = vsnprintf( h->presult + h->rsize, h->bufsize - h->rsize, fmt, _arglist );
 #endif
+    va_end( _arglist );
     h->rsize += _append_len;
     h->presult[h->rsize] = '\0';
     return 1;
 }
 
-/* Append Pure string, will automatically change the escape char */
+#if defined(__MIN_PURE_STRING__) && __MIN_PURE_STRING__ == 1
+#define __PURE_GT__         '>'
+#else
+#define __PURE_GT__         0
+#endif
+
+/* 
+    Class of each byte in a pure string, 0 for a byte copied as is, the 
+    escape letter for a byte written as a backslash and the letter, ' ' for
+    the white space kept as is, and '>' for the white space remover
+ */
+static const unsigned char __pure_string_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 't', 'n', 'v', 'f', 'r', 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    ' ', 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, __PURE_GT__, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* White space of the C locale, as isspace */
+#define __PURE_IS_SPACE__(c)    \
+    (__pure_string_class[(unsigned char)(c)] != 0 && \
+     __pure_string_class[(unsigned char)(c)] != '"' && \
+     __pure_string_class[(unsigned char)(c)] != '\\' && \
+     __pure_string_class[(unsigned char)(c)] != '>')
+
+/* Skip the bytes copied as is, return the index of the first byte to escape */
+static int __pure_string_skip( const char *s, int i, int l ) {
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+    const __m128i _quote = _mm_set1_epi8('"');
+    const __m128i _backslash = _mm_set1_epi8('\\');
+    const __m128i _space = _mm_set1_epi8(' ');
+    const __m128i _tab = _mm_set1_epi8('\t');
+    const __m128i _ctrl_max = _mm_set1_epi8('\r' - '\t');
+#if defined(__MIN_PURE_STRING__) && __MIN_PURE_STRING__ == 1
+    const __m128i _gt = _mm_set1_epi8('>');
+#endif
+    __m128i _v, _c, _hit;
+    int _mask;
+    for ( ; i + 16 <= l; i += 16 ) {
+        _v = _mm_loadu_si128((const __m128i *)(s + i));
+        /* '\t' to '\r' is one unsigned range */
+        _c = _mm_sub_epi8(_v, _tab);
+        _hit = _mm_cmpeq_epi8(_mm_min_epu8(_c, _ctrl_max), _c);
+        _hit = _mm_or_si128(_hit, _mm_cmpeq_epi8(_v, _space));
+        _hit = _mm_or_si128(_hit, _mm_cmpeq_epi8(_v, _quote));
+        _hit = _mm_or_si128(_hit, _mm_cmpeq_epi8(_v, _backslash));
+#if defined(__MIN_PURE_STRING__) && __MIN_PURE_STRING__ == 1
+        _hit = _mm_or_si128(_hit, _mm_cmpeq_epi8(_v, _gt));
+#endif
+        _mask = _mm_movemask_epi8(_hit);
+        if ( _mask != 0 ) return i + __builtin_ctz(_mask);
+    }
+#endif
+    while ( i < l && __pure_string_class[(unsigned char)s[i]] == 0 ) ++i;
+    return i;
+}
+
+/* 
+    Append Pure string, will automatically change the escape char.
+    The output is at most twice the input, reserved once and written in place
+ */
 int hcml_append_pure_string( hcml_node_t *h, const char *s, int l ) {
     int _w, _i, _all;
+    unsigned char _c;
+    char *_o;
+    if ( l <= 0 ) return 0;
+    if ( !__reserve_result(h, l * 2) ) return 0;
+    _o = h->presult + h->rsize;
     _w = _i = _all = 0;
     while ( _w < l ) {
-#if defined(__MIN_PURE_STRING__) && __MIN_PURE_STRING__ == 1
-        while ( _i < l && (!isspace(s[_i])) && s[_i] != '\\' && s[_i] != '\"' && s[_i] != '>' ) ++_i;
-#else
-        while ( _i < l && (!isspace(s[_i])) && s[_i] != '\\' && s[_i] != '\"' ) ++_i;
-#endif
+        _i = __pure_string_skip(s, _i, l);
         if ( (_i - _w) > 0 ) {
-            if ( !hcml_append_code_data(h, s + _w, _i - _w) ) return 0;
+            memcpy(_o, s + _w, _i - _w);
+            _o += (_i - _w);
             _all += (_i - _w);
         }
         if ( _i == l ) break;
-#if defined(__MIN_PURE_STRING__) && __MIN_PURE_STRING__ == 1
-        if ( s[_i] == '>' ) {
-            if ( !hcml_append_code_data(h, ">", 1) ) return 0;
-            ++_i;
-            ++_all;
-            while ( _i < l && isspace(s[_i]) ) {
-                ++_i;
-            }
-            _w = _i;
-            continue;
+        _c = __pure_string_class[(unsigned char)s[_i]];
+        ++_i;
+        ++_all;
+        if ( _c == '>' ) {
+            *_o++ = '>';
+            while ( _i < l && __PURE_IS_SPACE__(s[_i]) ) ++_i;
+        } else if ( _c == ' ' ) {
+            *_o++ = ' ';
+        } else {
+            *_o++ = '\\';
+            *_o++ = (char)_c;
         }
-#endif
+        _w = _i;
+    }
+    h->rsize = (int)(_o - h->presult);
+    h->presult[h->rsize] = '\0';
+    return _all;
+}
+
+/* Append escaped string, without removing any white space */
+int hcml_append_escaped_string( hcml_node_t *h, const char *s, int l ) {
+    int _w, _i;
+    _w = _i = 0;
+    while ( _w < l ) {
+        while ( _i < l && (!isspace(s[_i]) || s[_i] == ' ') && s[_i] != '\\' && s[_i] != '\"' ) ++_i;
+        if ( (_i - _w) > 0 ) {
+            if ( !hcml_append_code_data(h, s + _w, _i - _w) ) return 0;
+        }
+        if ( _i == l ) break;
         if ( s[_i] == '"' ) {
             if ( !hcml_append_code_data(h, "\\\"", 2) ) return 0;
-            _all += 1;
         } else if ( s[_i] == '\\' ) {
             if ( !hcml_append_code_data(h, "\\\\", 2) ) return 0;
-            _all += 1;
         } else if ( s[_i] == '\r' ) {
             if ( !hcml_append_code_data(h, "\\r", 2) ) return 0;
-            _all += 1;
         } else if ( s[_i] == '\n' ) {
             if ( !hcml_append_code_data(h, "\\n", 2) ) return 0;
-            _all += 1;
         } else if ( s[_i] == '\t' ) {
             if ( !hcml_append_code_data(h, "\\t", 2) ) return 0;
-            _all += 1;
         } else if ( s[_i] == '\v' ) {
             if ( !hcml_append_code_data(h, "\\v", 2) ) return 0;
-            _all += 1;
         } else if ( s[_i] == '\f' ) {
             if ( !hcml_append_code_data(h, "\\f", 2) ) return 0;
-            _all += 1;
-        } else if ( s[_i] == ' ' ) {
-            if ( !hcml_append_code_data(h, " ", 1) ) return 0;
-            _all += 1;
         }
         ++_i;
         _w = _i;
     }
-    return _all;
+    return l;
 }
 
 /*
@@ -776,14 +2409,15 @@ int hcml_append_pure_string( hcml_node_t *h, const char *s, int l ) {
 int hcml_parse( hcml_t h, const char * src_path ) {
     hcml_node_t *_h; /* Handler */
     char *__sbuf; /* Source Code Reading Buffer */
-    int __fdsrc; /* source file handler */
+    char __real_path[PATH_MAX]; /* Real path of source */
     int __fsize;
-    struct stat __fstat;
+    struct hcml_outline_t *_outlines;
+    unsigned long long _hash;
+    int _i;
 
     /* Init */
     _h = (hcml_node_t *)h;
     __sbuf = NULL;
-    __fdsrc = -1;
 
     /* The following error may caused by memory leak, we should not try to 
         touch the memory address in the handler */
@@ -797,24 +2431,37 @@ int hcml_parse( hcml_t h, const char * src_path ) {
     _h->errcode = 0;
     _h->errmsg[0] = '\0';
 
+    /* Reset the output, flush points and used includes */
+    _h->rsize = 0;
+    if ( _h->presult != NULL ) _h->presult[0] = '\0';
+    _h->output_hash[0] = '\0';
+    _h->inc_used_count = 0;
+    _h->flush_count = 0;
+    _h->flush_pending = 0;
+    _h->is_static = 0;
+    _h->static_size = 0;
+    _h->static_etag[0] = '\0';
+
+    /* Keep the source path to resolve the include */
+    if ( _h->src_path != NULL ) __hcml_free(_h->src_path);
+    _h->src_path = __hcml_strdup(realpath(src_path, __real_path) != NULL ? __real_path : src_path);
+    if ( _h->src_name != NULL ) __hcml_free(_h->src_name);
+    /* Same name as the includes, whatever path it was given by */
+    _h->src_name = ( _h->src_path != NULL ? __template_name(_h->src_path) : NULL );
+    _h->cur_inc = NULL;
+    _h->site_seq = 0;
+    _h->cache_depth = 0;
+    _h->raw_run_last = NULL;
+    _h->raw_run_left = 0;
+    _h->outline_count = 0;
+    for ( _i = 0; _i < _h->outline_alloc; ++_i ) {
+        _h->outlines[_i].size = 0;
+        if ( _h->outlines[_i].code != NULL ) _h->outlines[_i].code[0] = '\0';
+    }
+
     do {
-        __fdsrc = open(src_path, O_RDONLY);
-        if ( __fdsrc == -1 ) {
-            __set_error__(_h, HCML_ERR_ERRSRC, "Cannot open source file for reading");
-            break;
-        }
-        if ( fstat(__fdsrc, &__fstat) != 0 ) {
-            __set_error__(_h, HCML_ERR_ESTAT, "Stat source file error");
-            break;
-        }
-        /* Alloc 1KB for reading buffer */
-        __sbuf = (char *)malloc(__fstat.st_size);
-        if ( __sbuf == NULL ) {
-            __set_error__(_h, HCML_ERR_ESBUFALLOC, "Malloc Error for Reading Buffer");
-            break;
-        }
-        /* Read the whole source code into memory */
-        __fsize = read( __fdsrc, __sbuf, __fstat.st_size );
+        __fsize = __read_source_file(_h, src_path, &__sbuf);
+        if ( __fsize < 0 ) break;
 
         /* Init Output buffer 1KB */
         if ( _h->bufsize == 0 && _h->presult != NULL ) {
@@ -827,30 +2474,51 @@ int hcml_parse( hcml_t h, const char * src_path ) {
         }
         if ( _h->bufsize == 0 && _h->presult == NULL ) {
             _h->bufsize = 1024;
-            _h->presult = (char *)malloc(_h->bufsize);
+            _h->presult = (char *)__hcml_malloc(_h->bufsize);
             if ( _h->presult == NULL ) {
                 __set_error__(_h, HCML_ERR_ERBUFALLOC, "Malloc Error for Result Buffer");
                 break;
             }
             _h->presult[0] = '\0';
         }
-        if ( _h->print_method_l == 0 ) {
+        if ( _h->print_method_l == 0 && _h->render_mode == HCML_RENDER_PRINT ) {
             __set_error__(_h, HCML_ERR_EPRINT, "Invalidate Print Method");
             break;
         }
+        if ( _h->outline_size > 0 && 
+            _h->outline_alloc < (_h->outline_shards > 0 ? _h->outline_shards : 1) 
+        ) {
+            _i = (_h->outline_shards > 0 ? _h->outline_shards : 1);
+            _outlines = (struct hcml_outline_t *)__hcml_realloc(_h->outlines, 
+                sizeof(struct hcml_outline_t) * _i);
+            if ( _outlines == NULL ) {
+                __set_error__(_h, HCML_ERR_ERBUFALLOC, "Malloc Error for Outline Buffer");
+                break;
+            }
+            memset(_outlines + _h->outline_alloc, 0, 
+                sizeof(struct hcml_outline_t) * (_i - _h->outline_alloc));
+            _h->outlines = _outlines;
+            _h->outline_alloc = _i;
+        }
         /* Internal Paser Call */
         __parse_hcml__(_h, __sbuf, __fsize);
+        /* The schemas point to the tag tree */
+        __free_schemas(_h);
+        if ( _h->errcode == HCML_ERR_OK ) {
+            /* The outlined functions are a part of the output */
+            _hash = __hash_fnv1a(_h->presult, _h->rsize);
+            for ( _i = 0; _h->outline_count > 0 && _i < _h->outline_alloc; ++_i ) {
+                _hash = (_hash ^ __hash_fnv1a(_h->outlines[_i].code, _h->outlines[_i].size)) 
+                    * 1099511628211ULL;
+            }
+            snprintf(_h->output_hash, sizeof(_h->output_hash), "%016llx", _hash);
+        }
     } while ( 0 );
 
-    /* Close source file handler */
-    if ( __fdsrc != -1 ) {
-        close(__fdsrc);
-    }
     /* Release source buffer */
     if ( __sbuf != NULL ) {
-        free(__sbuf);
+        __hcml_free(__sbuf);
     }
-
     /* Return the last errcode as the fainal result */
     return _h->errcode;
 }
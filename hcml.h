@@ -89,6 +89,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #include <hcml_def.h>
 #include <hcml_cxx.h>
@@ -105,6 +106,17 @@
 #define HCML_ERR_EPRINT                 7   /* Invalidate Print Method */
 #define HCML_ERR_EPARSE                 8   /* Pasre error, see message for deatil */
 #define HCML_ERR_ESYNTAX                9   /* Syntax Error, see message for deatil */
+#define HCML_ERR_EFLUSH                 10  /* Invalidate Flush Method */
+#define HCML_ERR_EINCLUDE               11  /* Include Error, missing file or cycle */
+
+#define HCML_RENDER_PRINT               0   /* Invoke print method for each chunk */
+#define HCML_RENDER_COROUTINE           1   /* co_yield each chunk as std::string_view */
+#define HCML_RENDER_RAWBUF              2   /* memcpy to hcml_cur, checked against hcml_end */
+
+/* Render Probes */
+#define HCML_PROBE_NONE                 0   /* No probe, default */
+#define HCML_PROBE_COUNT                1   /* Count executions and bytes written */
+#define HCML_PROBE_CYCLES               2   /* Also count cycles */
 
 #ifdef __cplusplus
 extern "C" {
@@ -119,6 +131,21 @@ extern "C" {
  */
 typedef void *      hcml_t;
 
+/*
+    Allocator hooks, ctx is passed to every call
+ */
+typedef void * (*hcml_malloc_fn)( size_t size, void *ctx );
+typedef void * (*hcml_realloc_fn)( void *ptr, size_t size, void *ctx );
+typedef void (*hcml_free_fn)( void *ptr, void *ctx );
+
+/*
+    Set the allocator of the library, used by every allocation of all the
+    handlers. Any NULL function restores malloc, realloc and free. Set it 
+    before creating any handler, the memory is always released by the 
+    allocator which allocated it
+ */
+void hcml_set_allocator( hcml_malloc_fn alloc, hcml_realloc_fn re, hcml_free_fn fr, void *ctx );
+
 /* 
     Create an hcml handler 
  */
@@ -154,6 +181,12 @@ void hcml_set_error( hcml_t h, int code, const char * msgfmt, ... );
  */
 int hcml_get_output_size( hcml_t h );
 
+/*
+    Get the content hash of the output in hex, the same for the same template
+    and settings, empty when last parse failed
+ */
+const char * hcml_get_output_hash( hcml_t h );
+
 /*
     Set the static string print method
  */
@@ -164,6 +197,268 @@ void hcml_set_print_method( hcml_t h, const char* method );
 */
 const char * hcml_get_print_method( hcml_t h );
 
+/*
+    Set the flush method, invoked by cxx:flush and auto flush points
+ */
+void hcml_set_flush_method( hcml_t h, const char* method );
+
+/*
+    Get the flush method
+ */
+const char * hcml_get_flush_method( hcml_t h );
+
+/*
+    Set the reserve method. Before a cxx:each loop, the method is invoked with
+    the container size times the static bytes of the loop body,
+    as `method((container).size() * N)`. Empty to disable
+ */
+void hcml_set_reserve_method( hcml_t h, const char* method );
+
+/*
+    Get the reserve method
+ */
+const char * hcml_get_reserve_method( hcml_t h );
+
+/*
+    Set auto flush threshold, a flush point will be generated once 
+    the static string written since last flush reach the size. 
+    0 to disable
+ */
+void hcml_set_auto_flush( hcml_t h, int bytes );
+
+/*
+    Get auto flush threshold
+ */
+int hcml_get_auto_flush( hcml_t h );
+
+/*
+    Get the flush point count generated by last parse
+ */
+int hcml_get_flush_count( hcml_t h );
+
+/*
+    Get the template line of the flush point at index
+ */
+int hcml_get_flush_line( hcml_t h, int index );
+
+/*
+    Set the render mode, HCML_RENDER_PRINT, HCML_RENDER_COROUTINE 
+    or HCML_RENDER_RAWBUF.
+    In HCML_RENDER_RAWBUF mode, the generated code writes to the local
+    `char *hcml_cur, *hcml_end`, and the print method is invoked as
+    `method(hcml_cur, hcml_end, n)` when less than n bytes are left,
+    it must make room for n bytes or never return.
+ */
+void hcml_set_render_mode( hcml_t h, int mode );
+
+/*
+    Get the render mode
+ */
+int hcml_get_render_mode( hcml_t h );
+
+/*
+    Set the parsing threads, default is 0 to parse serially, negative to use
+    all online cores. A large source is split after the top-level tags and 
+    the pieces are parsed in parallel, the result and the error are the same
+    as the serial parsing
+ */
+void hcml_set_parse_threads( hcml_t h, int threads );
+
+/*
+    Get the parsing threads
+ */
+int hcml_get_parse_threads( hcml_t h );
+
+/*
+    Set the generating threads, default is 0 to generate serially, negative 
+    to use all online cores. The top-level statements are split into runs 
+    generated by a pool of threads into their own buffers, and joined in 
+    order, the output is the same as the serial generation. Only when no 
+    state is carried from a statement to the next: not in HCML_RENDER_RAWBUF
+    mode, without auto flush, probes, outlining, cxx:cache, registered tags
+    or the extend generator
+ */
+void hcml_set_generate_threads( hcml_t h, int threads );
+
+/*
+    Get the generating threads
+ */
+int hcml_get_generate_threads( hcml_t h );
+
+/*
+    Set the render probes, HCML_PROBE_NONE, HCML_PROBE_COUNT or HCML_PROBE_CYCLES.
+    Every cxx:each, branch of cxx:condition and top-level cxx:block is 
+    wrapped by a probe in hcml_runtime.hpp, keyed by template and line
+ */
+void hcml_set_probes( hcml_t h, int level );
+
+/*
+    Get the render probes level
+ */
+int hcml_get_probes( hcml_t h );
+
+/*
+    Enable or disable #line directives, default is 0.
+    Every statement of the generated code is preceded by 
+    `#line N "template"`, so the debugger and profiler report the template line,
+    and the glue code between them goes back to the generated file
+ */
+void hcml_set_line_directives( hcml_t h, int enable );
+
+/*
+    Get #line directives flag
+ */
+int hcml_get_line_directives( hcml_t h );
+
+/*
+    Set the name of the generated file, default is NULL to use the source 
+    path with ".inc". The glue code after a template body, a closing brace
+    or an auto flush point is preceded by `#line N "name"`, N is the line
+    after the directive in the output or the outlined shard
+ */
+void hcml_set_line_output( hcml_t h, const char *name );
+
+/*
+    Get the name of the generated file, NULL for the source path with ".inc"
+ */
+const char * hcml_get_line_output( hcml_t h );
+
+/*
+    Enable or disable constant folding, default is 0
+ */
+void hcml_set_const_folding( hcml_t h, int enable );
+
+/*
+    Get constant folding flag
+ */
+int hcml_get_const_folding( hcml_t h );
+
+/*
+    Check if the whole template of last parse is static string,
+    only be detected when constant folding is enabled
+ */
+int hcml_is_static( hcml_t h );
+
+/*
+    Get the static output size of last parse when the template is static
+ */
+int hcml_get_static_size( hcml_t h );
+
+/*
+    Get the ETag of the static output of last parse, a quoted content hash,
+    empty when the template is not static
+ */
+const char * hcml_get_static_etag( hcml_t h );
+
+/*
+    Set the static method. When set, a static template is output by invoking
+    the method with a hcml::rt::static_content, which contains the gzip and
+    deflate variants compressed at generation time and the ETag.
+    Only used in HCML_RENDER_PRINT mode, empty to disable
+ */
+void hcml_set_static_method( hcml_t h, const char* method );
+
+/*
+    Get the static method
+ */
+const char * hcml_get_static_method( hcml_t h );
+
+/*
+    Hash of a constant subscript key, computed at generation time
+ */
+typedef unsigned long long (*hcml_key_hash)( const char *key, int length );
+
+/*
+    Set the key type. When set, a cxx:subscript with only a cxx:string is
+    generated as `[type("key", length, hash)]`, so the key needs no hashing
+    or strlen at runtime, like hcml::rt::hashed_key. A key with octal, hex
+    or unicode escape is left as is. Empty to disable
+ */
+void hcml_set_key_type( hcml_t h, const char* type );
+
+/*
+    Get the key type
+ */
+const char * hcml_get_key_type( hcml_t h );
+
+/*
+    Set the hash function of the constant key, NULL to use 64-bit FNV-1a,
+    the same as hcml::rt::key_hash
+ */
+void hcml_set_key_hash( hcml_t h, hcml_key_hash fn );
+
+/*
+    Get the hash function of the constant key, NULL for FNV-1a
+ */
+hcml_key_hash hcml_get_key_hash( hcml_t h );
+
+/*
+    Outline the top-level statements of the C++ code into functions, a run
+    of statements is moved to a new function once it reaches N bytes of 
+    generated code, 0 to disable. The functions take the parameters, default
+    is "std::ostream &resp", and are called with the names of the parameters.
+    A top-level statement declaring a name, cxx:var with type, cxx:code or 
+    a registered tag, ends the outlining, and a statement with cxx:return is
+    kept in place. Not used in HCML_RENDER_COROUTINE mode
+ */
+void hcml_set_outline( hcml_t h, int size, const char *params );
+
+/*
+    Get the outline size
+ */
+int hcml_get_outline_size( hcml_t h );
+
+/*
+    Get the parameters of the outlined functions
+ */
+const char * hcml_get_outline_params( hcml_t h );
+
+/*
+    Set the shards of the outlined functions, default is 0. With 0 the 
+    functions are static and must be defined before the code calling them,
+    with N they have external linkage and are spread over N shards by size,
+    each shard can be compiled as a translation unit
+ */
+void hcml_set_outline_shards( hcml_t h, int shards );
+
+/*
+    Get the shards of the outlined functions
+ */
+int hcml_get_outline_shards( hcml_t h );
+
+/*
+    Get the outlined function count of last parse
+ */
+int hcml_get_outline_count( hcml_t h );
+
+/*
+    Get the code of the outlined functions in the shard, NULL when nothing 
+    is outlined or the shard is out of range
+ */
+const char * hcml_get_outline_code( hcml_t h, int shard, int *size );
+
+/*
+    Get the included templates used by last parse, nested ones included
+ */
+int hcml_get_include_count( hcml_t h );
+
+/*
+    Get the real path of the used include
+ */
+const char * hcml_get_include_path( hcml_t h, int index );
+
+/*
+    Get the name of last parsed template, relative to the working directory 
+    like the includes, used in the generated code and the header comment
+ */
+const char * hcml_get_source_name( hcml_t h );
+
+/*
+    Clear the included template cache, every included template is read
+    and parsed only once until the cache is cleared
+ */
+void hcml_clear_include_cache( hcml_t h );
+
 /*
     Set the language prefix, default is "cxx" and return the old
  */
@@ -180,12 +475,40 @@ const char * hcml_get_lang_prefix( hcml_t h );
 */
 hcml_lang_generator hcml_set_lang_generator( hcml_t h, hcml_lang_generator fp );
 
+/*
+    Set and get the old user data of the language generator.
+    userdata can be NULL
+ */
+void * hcml_set_lang_userdata( hcml_t h, void *userdata );
+
+/*
+    Get the user data of the language generator
+ */
+void * hcml_get_lang_userdata( hcml_t h );
+
 /*
     Set and get the old extend language generator function point.
     fp can be NULL
 */
 hcml_lang_generator hcml_set_exlang_generator( hcml_t h, hcml_lang_generator fp );
 
+/*
+    Register the generator of a tag, the name is after the language prefix.
+    A registered tag takes precedence over the built-in tag of the same name,
+    the user data is passed to the generator. fn can be NULL to unregister
+ */
+int hcml_register_tag( hcml_t h, const char *name, hcml_tag_generator fn, void *userdata );
+
+/*
+    Copy all registered tags of src to dst
+ */
+int hcml_copy_tags( hcml_t dst, hcml_t src );
+
+/*
+    Find the registered tag of the node, NULL if not registered
+ */
+const struct hcml_tag_entry_t * hcml_find_tag( hcml_node_t *h, const struct hcml_tag_t *tag );
+
 /* Dump debug structure info */
 void hcml_dump_tag( struct hcml_tag_t * root, int lv );
 
@@ -198,6 +521,33 @@ int hcml_append_code_format( hcml_node_t *h, const char *fmt, ... );
 /* Append Pure string, will automatically change the escape char */
 int hcml_append_pure_string( hcml_node_t *h, const char *s, int l );
 
+/* Append escaped string, without removing any white space */
+int hcml_append_escaped_string( hcml_node_t *h, const char *s, int l );
+
+/* 
+    Load the included template relative to the current template, 
+    cached on the handler, return NULL when error
+ */
+struct hcml_include_t * hcml_load_include( hcml_node_t *h, const char *src, int sl, int line );
+
+/* Get the display name of the template being generated */
+const char * hcml_current_name( hcml_node_t *h );
+
+/* Get the node table of the template being generated, NULL if not generating */
+const struct hcml_node_table_t * hcml_get_node_table( hcml_node_t *h );
+
+/* Get the index of the node in the node table, -1 if the node is not in it */
+int hcml_get_node_index( hcml_node_t *h, const struct hcml_tag_t *tag );
+
+/* 
+    Get the pointer tree view of the node in the node table, the view is
+    built on the first use. NULL if the node is not in it or failed to alloc
+ */
+struct hcml_tag_t * hcml_get_node_view( hcml_node_t *h, int index );
+
+/* Record a flush point at the template line */
+int hcml_append_flush_point( hcml_node_t *h, int line );
+
 /*
     Parse the input file and output to a dynamically allocated memory
  */
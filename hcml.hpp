@@ -36,6 +36,8 @@
 #include <hcml.h>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <functional>
 
 /* 
     This is a C++ HCML handler wrapper
@@ -55,9 +57,27 @@ public:
     hcml( const hcml& rhs ) : handler__( hcml_create() ) {
         if ( rhs.handler__ == 0 ) return;
         hcml_set_print_method(handler__, hcml_get_print_method(rhs.handler__));
+        hcml_set_flush_method(handler__, hcml_get_flush_method(rhs.handler__));
+        hcml_set_auto_flush(handler__, hcml_get_auto_flush(rhs.handler__));
+        hcml_set_reserve_method(handler__, hcml_get_reserve_method(rhs.handler__));
+        hcml_set_render_mode(handler__, hcml_get_render_mode(rhs.handler__));
+        hcml_set_const_folding(handler__, hcml_get_const_folding(rhs.handler__));
+        hcml_set_line_directives(handler__, hcml_get_line_directives(rhs.handler__));
+        hcml_set_line_output(handler__, hcml_get_line_output(rhs.handler__));
+        hcml_set_probes(handler__, hcml_get_probes(rhs.handler__));
+        hcml_set_parse_threads(handler__, hcml_get_parse_threads(rhs.handler__));
+        hcml_set_generate_threads(handler__, hcml_get_generate_threads(rhs.handler__));
+        hcml_set_static_method(handler__, hcml_get_static_method(rhs.handler__));
+        hcml_set_key_type(handler__, hcml_get_key_type(rhs.handler__));
+        hcml_set_key_hash(handler__, hcml_get_key_hash(rhs.handler__));
+        hcml_set_outline(handler__, hcml_get_outline_size(rhs.handler__), 
+            hcml_get_outline_params(rhs.handler__));
+        hcml_set_outline_shards(handler__, hcml_get_outline_shards(rhs.handler__));
         hcml_set_lang_prefix(handler__, hcml_get_lang_prefix(rhs.handler__));
         hcml_set_lang_generator(handler__, hcml_set_lang_generator(rhs.handler__, NULL));
+        hcml_set_lang_userdata(handler__, hcml_get_lang_userdata(rhs.handler__));
         hcml_set_exlang_generator(handler__, hcml_set_exlang_generator(rhs.handler__, NULL));
+        hcml_copy_tags(handler__, rhs.handler__);
     }
     hcml( hcml&& rhs ) : handler__(rhs.handler__) {
         rhs.handler__ = 0;
@@ -65,9 +85,27 @@ public:
     hcml & operator = ( const hcml& rhs ) {
         if ( this == &rhs ) return *this;
         hcml_set_print_method(handler__, hcml_get_print_method(rhs.handler__));
+        hcml_set_flush_method(handler__, hcml_get_flush_method(rhs.handler__));
+        hcml_set_auto_flush(handler__, hcml_get_auto_flush(rhs.handler__));
+        hcml_set_reserve_method(handler__, hcml_get_reserve_method(rhs.handler__));
+        hcml_set_render_mode(handler__, hcml_get_render_mode(rhs.handler__));
+        hcml_set_const_folding(handler__, hcml_get_const_folding(rhs.handler__));
+        hcml_set_line_directives(handler__, hcml_get_line_directives(rhs.handler__));
+        hcml_set_line_output(handler__, hcml_get_line_output(rhs.handler__));
+        hcml_set_probes(handler__, hcml_get_probes(rhs.handler__));
+        hcml_set_parse_threads(handler__, hcml_get_parse_threads(rhs.handler__));
+        hcml_set_generate_threads(handler__, hcml_get_generate_threads(rhs.handler__));
+        hcml_set_static_method(handler__, hcml_get_static_method(rhs.handler__));
+        hcml_set_key_type(handler__, hcml_get_key_type(rhs.handler__));
+        hcml_set_key_hash(handler__, hcml_get_key_hash(rhs.handler__));
+        hcml_set_outline(handler__, hcml_get_outline_size(rhs.handler__), 
+            hcml_get_outline_params(rhs.handler__));
+        hcml_set_outline_shards(handler__, hcml_get_outline_shards(rhs.handler__));
         hcml_set_lang_prefix(handler__, hcml_get_lang_prefix(rhs.handler__));
         hcml_set_lang_generator(handler__, hcml_set_lang_generator(rhs.handler__, NULL));
+        hcml_set_lang_userdata(handler__, hcml_get_lang_userdata(rhs.handler__));
         hcml_set_exlang_generator(handler__, hcml_set_exlang_generator(rhs.handler__, NULL));
+        hcml_copy_tags(handler__, rhs.handler__);
         return *this;
     }
     hcml & operator = ( hcml&& rhs ) {
@@ -119,13 +157,161 @@ public:
         hcml_set_print_method( handler__, method.c_str() );
     }
 
-    // Function Point
-    void set_lang_generator( fp_lang_t arg ) {
+    // Flush Method
+    const char * get_flush_method() const {
+        if ( handler__ == 0 ) return NULL;
+        return hcml_get_flush_method(handler__);
+    }
+
+    void set_flush_method( const std::string& method ) {
         if ( handler__ == 0 ) return;
-        auto _fp = arg.target< hcml_lang_generator >();
-        if ( _fp ) {
-            hcml_set_lang_generator(handler__, *_fp );
+        hcml_set_flush_method( handler__, method.c_str() );
+    }
+
+    // Reserve Method
+    const char * get_reserve_method() const {
+        if ( handler__ == 0 ) return NULL;
+        return hcml_get_reserve_method(handler__);
+    }
+
+    void set_reserve_method( const std::string& method ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_reserve_method( handler__, method.c_str() );
+    }
+
+    // Auto Flush
+    int get_auto_flush() const {
+        if ( handler__ == 0 ) return 0;
+        return hcml_get_auto_flush(handler__);
+    }
+
+    void set_auto_flush( int bytes ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_auto_flush( handler__, bytes );
+    }
+
+    // Flush points of last parse
+    std::vector< int > flush_lines() const {
+        std::vector< int > _lines;
+        if ( handler__ == 0 ) return _lines;
+        for ( int i = 0; i < hcml_get_flush_count(handler__); ++i ) {
+            _lines.push_back(hcml_get_flush_line(handler__, i));
         }
+        return _lines;
+    }
+
+    // Parsing Threads
+    void set_parse_threads( int threads ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_parse_threads( handler__, threads );
+    }
+
+    // Generating Threads
+    void set_generate_threads( int threads ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_generate_threads( handler__, threads );
+    }
+
+    // Render Probes
+    void set_probes( int level ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_probes( handler__, level );
+    }
+
+    // Line Directives
+    void set_line_directives( bool enable ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_line_directives( handler__, enable ? 1 : 0 );
+    }
+    const char * get_line_output() const {
+        if ( handler__ == 0 ) return NULL;
+        return hcml_get_line_output(handler__);
+    }
+    void set_line_output( const std::string& name ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_line_output( handler__, name.c_str() );
+    }
+
+    // Constant Folding
+    void set_const_folding( bool enable ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_const_folding( handler__, enable ? 1 : 0 );
+    }
+
+    bool is_static() const {
+        if ( handler__ == 0 ) return false;
+        return hcml_is_static(handler__) == 1;
+    }
+
+    // Static Method
+    const char * get_static_method() const {
+        if ( handler__ == 0 ) return NULL;
+        return hcml_get_static_method(handler__);
+    }
+
+    void set_static_method( const std::string& method ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_static_method( handler__, method.c_str() );
+    }
+
+    // Key Type
+    const char * get_key_type() const {
+        if ( handler__ == 0 ) return NULL;
+        return hcml_get_key_type(handler__);
+    }
+
+    void set_key_type( const std::string& type ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_key_type( handler__, type.c_str() );
+    }
+
+    void set_key_hash( hcml_key_hash fn ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_key_hash( handler__, fn );
+    }
+
+    const char * static_etag() const {
+        if ( handler__ == 0 ) return NULL;
+        return hcml_get_static_etag(handler__);
+    }
+
+    // Outlined Functions
+    void set_outline( int size, const std::string& params = std::string() ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_outline( handler__, size, params.c_str() );
+    }
+
+    void set_outline_shards( int shards ) {
+        if ( handler__ == 0 ) return;
+        hcml_set_outline_shards( handler__, shards );
+    }
+
+    int outline_count() const {
+        if ( handler__ == 0 ) return 0;
+        return hcml_get_outline_count(handler__);
+    }
+
+    std::string outline_code( int shard ) const {
+        int _size = 0;
+        const char *_code;
+        if ( handler__ == 0 ) return std::string();
+        _code = hcml_get_outline_code(handler__, shard, &_size);
+        return ( _code == NULL ? std::string() : std::string(_code, _size) );
+    }
+
+    // Include Cache
+    void clear_include_cache() {
+        if ( handler__ == 0 ) return;
+        hcml_clear_include_cache( handler__ );
+    }
+
+    // Function Point, return false if arg is not a plain function
+    bool set_lang_generator( fp_lang_t arg ) {
+        if ( handler__ == 0 ) return false;
+        auto _fp = arg.target< hcml_lang_generator >();
+        if ( !_fp ) return false;
+        hcml_set_lang_generator(handler__, *_fp );
+        return true;
     }
 
     void set_exlang_generator( fp_lang_t arg ) {
@@ -136,11 +322,66 @@ public:
         }
     }
 
+    // Registered Tag Generator
+    bool register_tag( const std::string& name, hcml_tag_generator fn, void *userdata = NULL ) {
+        if ( handler__ == 0 ) return false;
+        return ( HCML_ERR_OK == hcml_register_tag(handler__, name.c_str(), fn, userdata) );
+    }
+
     // Do Parse
     bool parse( const std::string& source_path ) {
         if ( handler__ == 0 ) return false;
         return ( HCML_ERR_OK == hcml_parse(handler__, source_path.c_str()) );
     }
+
+    /*
+        Template generator base, derive as class G : public hcml::generator<G>
+        and hide on_string and on_tag. The handlers are resolved at compile time
+        and inlined into the tree walk, the state lives in the generator object
+     */
+    template < typename _TyDerived >
+    class generator {
+    public:
+        // Generate the node and all its siblings
+        int visit( hcml_node_t *h, struct hcml_tag_t *tag, const char *suf ) {
+            _TyDerived *_self = static_cast< _TyDerived * >(this);
+            int _r;
+            for ( ; tag != NULL; tag = tag->n_tag ) {
+                _r = ( tag->is_tag ? 
+                    _self->on_tag(h, tag, suf) : _self->on_string(h, tag, suf) );
+                if ( _r != HCML_ERR_OK ) return _r;
+            }
+            return HCML_ERR_OK;
+        }
+        // Default string handler, output nothing
+        int on_string( hcml_node_t *, struct hcml_tag_t *, const char * ) {
+            return HCML_ERR_OK;
+        }
+        // Default tag handler, generate the children
+        int on_tag( hcml_node_t *h, struct hcml_tag_t *tag, const char *suf ) {
+            return static_cast< _TyDerived * >(this)->visit(h, tag->c_tag, suf);
+        }
+    };
+
+    // Do Parse with the generator object, which has a visit method like hcml::generator
+    template < typename _TyGenerator >
+    bool parse( const std::string& source_path, _TyGenerator& gen ) {
+        if ( handler__ == 0 ) return false;
+        hcml_lang_generator _ofp = hcml_set_lang_generator(
+            handler__, &hcml::visit_generator__< _TyGenerator > );
+        void *_oud = hcml_set_lang_userdata(handler__, &gen);
+        int _r = hcml_parse(handler__, source_path.c_str());
+        hcml_set_lang_generator(handler__, _ofp);
+        hcml_set_lang_userdata(handler__, _oud);
+        return ( HCML_ERR_OK == _r );
+    }
+
+private:
+    // The only indirect call, for the root of the template
+    template < typename _TyGenerator >
+    static int visit_generator__( hcml_node_t *h, struct hcml_tag_t *root, const char *suf ) {
+        return static_cast< _TyGenerator * >(hcml_get_lang_userdata(h))->visit(h, root, suf);
+    }
 };
 
 template < typename _TyStream >
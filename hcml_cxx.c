@@ -29,108 +29,138 @@
 */
 
 #include "hcml.h"
+#include "hcml_util.h"
+#include <limits.h>
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Node table of the template being generated */
+struct hcml_node_table_t * __cxx_table( hcml_node_t *h ) {
+    return ( h->cur_inc != NULL ? h->cur_inc->table : h->table );
+}
+
+/* Tag name or string of the node */
+const char * __cxx_data( const struct hcml_node_table_t *t, uint32_t node ) {
+    if ( t->nodes[node].flags & HCML_CNODE_FOLDED ) return t->fold[node];
+    return t->source + t->nodes[node].data_off;
+}
+
 /* Get Properties Count  */
-int __tag_prop_count( struct hcml_tag_t * tag ) {
-    int _c;
-    struct hcml_prop_t * __prop;
-    _c = 0;
-    __prop = tag->p_root;
-    while ( __prop != NULL ) {
-        ++_c;
-        __prop = __prop->n_prop;
-    }
-    return _c;
+int __tag_prop_count( const struct hcml_node_table_t *t, uint32_t node ) {
+    return (int)t->nodes[node].prop_count;
 }
 
 /* Get child tag count */
-int __tag_child_count( struct hcml_tag_t * tag ) {
+int __tag_child_count( const struct hcml_node_table_t *t, uint32_t node ) {
     int _c;
-    struct hcml_tag_t * __tag;
+    uint32_t __tag;
     _c = 0;
-    __tag = tag->c_tag;
-    while ( __tag != NULL ) {
+    __tag = t->nodes[node].child;
+    while ( __tag != HCML_NODE_NONE ) {
         ++_c;
-        __tag = __tag->n_tag;
+        __tag = t->nodes[__tag].next;
     }
     return _c;
 }
 
 /* Get xth child */
-struct hcml_tag_t* __child_tag_at_index( struct hcml_tag_t * root_tag, int index ) {
+uint32_t __child_tag_at_index( const struct hcml_node_table_t *t, uint32_t node, int index ) {
     int _c;
-    struct hcml_tag_t * __tag;
+    uint32_t __tag;
     _c = 0;
-    __tag = root_tag->c_tag;
-    while ( _c != index && __tag != NULL ) {
+    __tag = t->nodes[node].child;
+    while ( _c != index && __tag != HCML_NODE_NONE ) {
         ++_c;
-        __tag = __tag->n_tag;
+        __tag = t->nodes[__tag].next;
     }
     return __tag;
 }
 
-/* Break sibling relation and generate code */
-int __break_sibling_and_generate( hcml_node_t *h, struct hcml_tag_t *root_tag, int index, const char* suf ) {
-    int _c;
-    struct hcml_tag_t * __tag, * __sibling;
-    _c = 0;
-    __tag = root_tag;
-    while ( _c != index ) {
-        __tag = __tag->n_tag;
-        ++_c;
+/* Generate the xth child without its siblings */
+int __generate_child_at_index( hcml_node_t *h, uint32_t node, int index, const char* suf ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    uint32_t __tag = __child_tag_at_index(_t, node, index);
+    return hcml_generate_cxx_nodes(h, __tag, _t->nodes[__tag].next, suf);
+}
+
+int __cxx_is_tag( const struct hcml_node_table_t *t, uint32_t node, const char *tagname ) {
+    return strncmp( __cxx_data(t, node), tagname, t->nodes[node].data_len ) == 0;
+}
+
+/* Get the property of the node, prop is filled and returned, NULL if not found */
+struct hcml_prop_t *__cxx_get_prop( 
+    const struct hcml_node_table_t *t, uint32_t node, const char* propname, struct hcml_prop_t *prop 
+) {
+    const struct hcml_cnode_t *_n = t->nodes + node;
+    const struct hcml_cprop_t *_p;
+    uint32_t _i;
+    for ( _i = 0; _i < _n->prop_count; ++_i ) {
+        _p = t->props + _n->prop + _i;
+        if ( strncmp( t->source + _p->key_off, propname, _p->key_len ) == 0 ) {
+            prop->key = t->source + _p->key_off;
+            prop->kl = (int)_p->key_len;
+            prop->value = ( _p->value_off == HCML_NODE_NONE ? 
+                __value_true : t->source + _p->value_off );
+            prop->vl = (int)_p->value_len;
+            prop->n_prop = NULL;
+            return prop;
+        }
     }
-    __sibling = __tag->n_tag;
-    __tag->n_tag = NULL;
-    hcml_generate_cxx_lang(h, __tag, suf);
-    __tag->n_tag = __sibling;
-    return h->errcode;
+    return NULL;
 }
 
-int __cxx_is_tag( struct hcml_tag_t *tag, const char *tagname ) {
-    return strncmp( tag->data_string, tagname, tag->dl ) == 0;
+/* Check if the node has the property */
+int __cxx_has_prop( const struct hcml_node_table_t *t, uint32_t node, const char* propname ) {
+    struct hcml_prop_t _p;
+    return __cxx_get_prop(t, node, propname, &_p) != NULL;
 }
 
-struct hcml_prop_t *__cxx_get_prop( struct hcml_tag_t *tag, const char* propname ) {
-    struct hcml_prop_t * _p = tag->p_root;
-    while ( _p != NULL ) {
-        if ( strncmp( _p->key, propname, _p->kl ) == 0 ) break;
-        _p = _p->n_prop;
+/* Check if the tag is a statement of a block out of any loop body */
+int __cxx_is_flushable_statement( const struct hcml_node_table_t *t, uint32_t node ) {
+    uint32_t _f = t->nodes[node].parent;
+    if ( _f != HCML_NODE_NONE && !__cxx_is_tag(t, _f, "block") ) return 0;
+    while ( _f != HCML_NODE_NONE ) {
+        if ( __cxx_is_tag(t, _f, "each") || __cxx_is_tag(t, _f, "for") || 
+            __cxx_is_tag(t, _f, "while") || __cxx_is_tag(t, _f, "do") ) return 0;
+        _f = t->nodes[_f].parent;
     }
-    return _p;
+    return 1;
 }
 
 /* Generate binary operator */
-int __generate_cxx_binary_operator( hcml_node_t *h, struct hcml_tag_t *op_tag, const char* op ) {
-    if ( __tag_child_count(op_tag) != 2 ) {
+int __generate_cxx_binary_operator( hcml_node_t *h, uint32_t node, const char* op ) {
+    if ( __tag_child_count(__cxx_table(h), node) != 2 ) {
         hcml_set_error(h, HCML_ERR_ESYNTAX, 
             "Syntax Error, missing tag arround %s", op);
         return HCML_ERR_ESYNTAX;
     }
-    if ( HCML_ERR_OK != __break_sibling_and_generate(h, op_tag->c_tag, 0, NULL) ) return h->errcode;
+    if ( HCML_ERR_OK != __generate_child_at_index(h, node, 0, NULL) ) return h->errcode;
     if ( !hcml_append_code_format(h, " %s ", op) ) return h->errcode;
-    if ( HCML_ERR_OK != __break_sibling_and_generate(h, op_tag->c_tag, 1, NULL) ) return h->errcode;
+    if ( HCML_ERR_OK != __generate_child_at_index(h, node, 1, NULL) ) return h->errcode;
     return HCML_ERR_OK;
 }
 
 /* Generate continues operator */
-int __generate_cxx_self_return_operator( hcml_node_t *h, struct hcml_tag_t *op_tag, const char *op ) {
+int __generate_cxx_self_return_operator( hcml_node_t *h, uint32_t node, const char *op ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
     int _i = 0;
-    int _cc = __tag_child_count(op_tag);
+    int _cc = __tag_child_count(_t, node);
     if ( _cc <= 1 ) {
         hcml_set_error(h, HCML_ERR_ESYNTAX, 
             "Syntax Error, at least 2 child nodes in %.*s", 
-            op_tag->dl, op_tag->data_string);
+            (int)_t->nodes[node].data_len, __cxx_data(_t, node));
         return HCML_ERR_ESYNTAX;
     }
     for ( ; _i < (_cc - 1); ++_i ) {
-        if ( HCML_ERR_OK != __break_sibling_and_generate(h, op_tag->c_tag, _i, NULL) ) return h->errcode;
+        if ( HCML_ERR_OK != __generate_child_at_index(h, node, _i, NULL) ) return h->errcode;
         if ( !hcml_append_code_format(h, " %s ", op) ) return h->errcode;
     }
-    return __break_sibling_and_generate(h, op_tag->c_tag, _i, NULL);
+    return __generate_child_at_index(h, node, _i, NULL);
 }
 
 /* Generate Keyword tag */
@@ -139,78 +169,857 @@ int __generate_cxx_keyword( hcml_node_t *h, const char *keyword ) {
     return h->errcode;
 }
 
+/* Generate flush point */
+int __generate_cxx_flush( hcml_node_t *h, int bline ) {
+    /* The body of cxx:cache is rendered into a side buffer, nothing to flush */
+    if ( h->cache_depth > 0 ) return HCML_ERR_OK;
+    if ( h->render_mode == HCML_RENDER_COROUTINE ) {
+        /* An empty chunk tells the consumer to send what it has got */
+        if ( !hcml_append_code_format(h, "co_yield std::string_view();") ) return h->errcode;
+        if ( !hcml_append_flush_point(h, bline) ) return h->errcode;
+        return HCML_ERR_OK;
+    }
+    if ( h->flush_method_l == 0 ) {
+        hcml_set_error(h, HCML_ERR_EFLUSH, 
+            "Invalidate Flush Method, flush at line: %d", bline);
+        return HCML_ERR_EFLUSH;
+    }
+    if ( h->render_mode == HCML_RENDER_RAWBUF ) {
+        /* The pending bytes are in the caller's buffer before the cursor */
+        if ( !hcml_append_code_format(h, "%s(hcml_cur, hcml_end);", h->flush_method) ) 
+            return h->errcode;
+    } else {
+        if ( !hcml_append_code_format(h, "%s();", h->flush_method) ) return h->errcode;
+    }
+    if ( !hcml_append_flush_point(h, bline) ) return h->errcode;
+    return HCML_ERR_OK;
+}
+
+/* Check if probes should be generated */
+int __cxx_has_probe( hcml_node_t *h ) {
+    /* The body of cxx:cache is not written to the output directly */
+    return h->probes != HCML_PROBE_NONE && h->cache_depth == 0;
+}
+
+/* Declare a probe site and start the probe in current C++ scope */
+int __generate_cxx_probe( hcml_node_t *h, int bline, const char *kind ) {
+    const char *_name = hcml_current_name(h);
+    int _seq = h->site_seq++;
+    if ( !hcml_append_code_format(h, "static hcml::rt::probe_site hcml_probe_%d(\"", _seq) ) 
+        return h->errcode;
+    hcml_append_escaped_string(h, _name, (int)strlen(_name));
+    hcml_append_code_format(h, "\", %d, \"%s\");\nhcml::rt::probe_scope< %s > hcml_ps_%d(hcml_probe_%d);\n", 
+        bline, kind, (h->probes == HCML_PROBE_CYCLES ? "true" : "false"), _seq, _seq);
+    return h->errcode;
+}
+
+/* Add the bytes written to the probes */
+int __generate_cxx_probe_bytes( hcml_node_t *h, const char *size ) {
+    if ( !__cxx_has_probe(h) ) return HCML_ERR_OK;
+    hcml_append_code_format(h, "\nhcml::rt::probe_bytes() += %s;", size);
+    return h->errcode;
+}
+
+/* Generate the only child body wrapped with a probe */
+int __generate_cxx_probe_body( hcml_node_t *h, uint32_t body, const char *kind, const char *suf ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    /* More than one statement is not wrapped, keep them as they are */
+    if ( !__cxx_has_probe(h) || _t->nodes[body].next != HCML_NODE_NONE ) {
+        return hcml_generate_cxx_nodes(h, body, HCML_NODE_NONE, suf);
+    }
+    if ( !hcml_append_code_format(h, "{\n") ) return h->errcode;
+    if ( HCML_ERR_OK != __generate_cxx_probe(h, (int)_t->nodes[body].bline, kind) ) return h->errcode;
+    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, body, HCML_NODE_NONE, "\n") ) return h->errcode;
+    hcml_append_code_format(h, "}");
+    return h->errcode;
+}
+
+/* 
+    Generate any bytes as a string literal, split into lines, the compiler 
+    reads it much faster than a brace list of numbers. Return the size or -1
+ */
+int __generate_cxx_string_literal( hcml_node_t *h, const unsigned char *data, int l ) {
+    char _line[128];
+    int _i, _ll;
+    _ll = 0;
+    _line[_ll++] = '"';
+    for ( _i = 0; _i < l; ++_i ) {
+        if ( data[_i] == '\n' ) {
+            _line[_ll++] = '\\';
+            _line[_ll++] = 'n';
+        } else if ( data[_i] == '"' || data[_i] == '\\' || data[_i] == '?' ) {
+            /* ? for the trigraphs */
+            _line[_ll++] = '\\';
+            _line[_ll++] = (char)data[_i];
+        } else if ( data[_i] >= 0x20 && data[_i] < 0x7F ) {
+            _line[_ll++] = (char)data[_i];
+        } else {
+            /* Always 3 octal digits, the next char is never taken in */
+            _line[_ll++] = '\\';
+            _line[_ll++] = (char)('0' + (data[_i] >> 6));
+            _line[_ll++] = (char)('0' + ((data[_i] >> 3) & 7));
+            _line[_ll++] = (char)('0' + (data[_i] & 7));
+        }
+        if ( _ll >= 76 || (data[_i] == '\n' && _i + 1 < l) ) {
+            _line[_ll++] = '"';
+            _line[_ll++] = '\n';
+            if ( !hcml_append_code_data(h, _line, _ll) ) return -1;
+            _ll = 0;
+            _line[_ll++] = '"';
+        }
+    }
+    _line[_ll++] = '"';
+    if ( !hcml_append_code_data(h, _line, _ll) ) return -1;
+    return l;
+}
+
+/* Generate a byte array constant, return the size or -1 */
+int __generate_cxx_byte_array( hcml_node_t *h, const char *name, const unsigned char *data, int l ) {
+    if ( !hcml_append_code_format(h, "static const unsigned char %s[] =\n", name) ) return -1;
+    if ( __generate_cxx_string_literal(h, data, l) < 0 ) return -1;
+    if ( !hcml_append_code_format(h, ";\n") ) return -1;
+    return l;
+}
+
+#ifdef HAVE_ZLIB_H
+/* zlib allocates through the allocator of the library too */
+voidpf __cxx_zalloc( voidpf opaque, uInt items, uInt size ) {
+    (void)opaque;
+    return __hcml_malloc((size_t)items * size);
+}
+
+void __cxx_zfree( voidpf opaque, voidpf address ) {
+    (void)opaque;
+    __hcml_free(address);
+}
+#endif
+
+/* 
+    Compress the data at generation time and generate the byte array, 
+    gzip or zlib(HTTP deflate) format according to window bits, nothing is
+    generated if not smaller than the limit. Return the compressed size, 
+    0 when not supported or not generated, or -1
+ */
+int __generate_cxx_compressed( hcml_node_t *h, const char *name, const char *data, int l, 
+    int wbits, int limit 
+) {
+#ifdef HAVE_ZLIB_H
+    z_stream _zs;
+    gz_header _gh;
+    unsigned char *_out;
+    int _size;
+    memset(&_zs, 0, sizeof(_zs));
+    _zs.zalloc = __cxx_zalloc;
+    _zs.zfree = __cxx_zfree;
+    if ( Z_OK != deflateInit2(&_zs, Z_BEST_COMPRESSION, Z_DEFLATED, wbits, 8, Z_DEFAULT_STRATEGY) ) {
+        return 0;
+    }
+    /* No time and unknown OS in the gzip header, the same bytes on every host */
+    if ( wbits > 15 ) {
+        memset(&_gh, 0, sizeof(_gh));
+        _gh.os = 255;
+        deflateSetHeader(&_zs, &_gh);
+    }
+    _size = (int)deflateBound(&_zs, (uLong)l);
+    _out = (unsigned char *)__hcml_malloc(_size);
+    if ( _out == NULL ) {
+        deflateEnd(&_zs);
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Compression Buffer");
+        return -1;
+    }
+    _zs.next_in = (Bytef *)data;
+    _zs.avail_in = (uInt)l;
+    _zs.next_out = _out;
+    _zs.avail_out = (uInt)_size;
+    if ( Z_STREAM_END != deflate(&_zs, Z_FINISH) ) {
+        deflateEnd(&_zs);
+        __hcml_free(_out);
+        return 0;
+    }
+    _size = (int)_zs.total_out;
+    deflateEnd(&_zs);
+    if ( _size >= limit ) {
+        __hcml_free(_out);
+        return 0;
+    }
+    _size = __generate_cxx_byte_array(h, name, _out, _size);
+    __hcml_free(_out);
+    return _size;
+#else
+    (void)h; (void)name; (void)data; (void)l; (void)wbits; (void)limit;
+    return 0;
+#endif
+}
+
+/* Generate the whole static template as a single constant */
+int __generate_cxx_static_template( hcml_node_t *h, const char *data, int dl ) {
+    int _gzip_size, _deflate_size;
+    if ( !hcml_append_code_format(h, "static const char hcml_static_data[] = \"") ) return -1;
+    if ( dl != hcml_append_escaped_string(h, data, dl) ) return -1;
+    if ( !hcml_append_code_format(h, "\";\nstatic const int hcml_static_size = %d;\n", 
+        dl) ) return -1;
+    if ( h->static_method_l > 0 && h->render_mode == HCML_RENDER_PRINT ) {
+        /* 15 + 16 for gzip wrapper, 15 for zlib wrapper */
+        _gzip_size = __generate_cxx_compressed(h, "hcml_static_gzip", 
+            data, dl, 15 + 16, dl);
+        if ( _gzip_size < 0 ) return -1;
+        _deflate_size = __generate_cxx_compressed(h, "hcml_static_deflate", 
+            data, dl, 15, dl);
+        if ( _deflate_size < 0 ) return -1;
+        if ( !hcml_append_code_format(h, 
+            "static const hcml::rt::static_content hcml_static_content = {\n"
+            "hcml_static_data, hcml_static_size,\n%s, %d,\n%s, %d,\n\"",
+            (_gzip_size > 0 ? "hcml_static_gzip" : "nullptr"), _gzip_size,
+            (_deflate_size > 0 ? "hcml_static_deflate" : "nullptr"), _deflate_size) 
+        ) return -1;
+        hcml_append_escaped_string(h, h->static_etag, (int)strlen(h->static_etag));
+        if ( !hcml_append_code_format(h, "\", \"text/html\"\n};\n%s(hcml_static_content);", 
+            h->static_method) ) return -1;
+        if ( HCML_ERR_OK != __generate_cxx_probe_bytes(h, "hcml_static_size") ) return -1;
+        return dl;
+    }
+    if ( h->render_mode == HCML_RENDER_COROUTINE ) {
+        if ( !hcml_append_code_format(h, 
+            "co_yield std::string_view(hcml_static_data, hcml_static_size);") ) return -1;
+    } else if ( h->render_mode == HCML_RENDER_RAWBUF ) {
+        if ( !hcml_append_code_format(h, 
+            "if ( (size_t)(hcml_end - hcml_cur) < (size_t)hcml_static_size ) "
+            "%s(hcml_cur, hcml_end, hcml_static_size);\n"
+            "memcpy(hcml_cur, hcml_static_data, hcml_static_size);\n"
+            "hcml_cur += hcml_static_size;", h->print_method) ) return -1;
+    } else {
+        if ( !hcml_append_code_format(h, 
+            "%s(hcml_static_data, hcml_static_size);", h->print_method) ) return -1;
+    }
+    if ( HCML_ERR_OK != __generate_cxx_probe_bytes(h, "hcml_static_size") ) return -1;
+    return dl;
+}
+
+/* Generate the included template in place */
+int __generate_cxx_include( hcml_node_t *h, uint32_t node, const char *suf ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    struct hcml_prop_t _src;
+    struct hcml_include_t *_inc, *_saved_inc;
+    if ( __cxx_get_prop(_t, node, "src", &_src) == NULL ) {
+        hcml_set_error(h, HCML_ERR_ESYNTAX, 
+            "Syntax Error, missing src for include at line: %d", (int)_t->nodes[node].bline);
+        return HCML_ERR_ESYNTAX;
+    }
+    _inc = hcml_load_include(h, _src.value, _src.vl, (int)_t->nodes[node].bline);
+    if ( _inc == NULL ) return h->errcode;
+    if ( _inc->root == HCML_NODE_NONE ) return HCML_ERR_OK;
+    _saved_inc = h->cur_inc;
+    h->cur_inc = _inc;
+    /* Workers share the include, cycles have been checked before */
+    if ( !h->is_worker ) _inc->busy = 1;
+    hcml_generate_cxx_nodes(h, _inc->root, HCML_NODE_NONE, suf);
+    if ( !h->is_worker ) _inc->busy = 0;
+    h->cur_inc = _saved_inc;
+    return h->errcode;
+}
+
+int __cxx_fold_minimize( const char *s, int l, char *out );
+
+/* Output size of a string node */
+int __cxx_static_string_size( const struct hcml_node_table_t *t, uint32_t node ) {
+    if ( t->nodes[node].flags & HCML_CNODE_FOLDED ) return (int)t->nodes[node].data_len;
+    return __cxx_fold_minimize(t->source + t->nodes[node].data_off, (int)t->nodes[node].data_len, NULL);
+}
+
+/* Check if the node is a member of a straight-line run */
+int __cxx_is_raw_run_node( const struct hcml_node_table_t *t, uint32_t node ) {
+    return !(t->nodes[node].flags & HCML_CNODE_TAG) || 
+        ( t->nodes[node].data_len == 5 && strncmp(__cxx_data(t, node), "print", 5) == 0 );
+}
+
+/* 
+    Begin a straight-line run of static strings and prints if not in one,
+    the run stops before stop. Room for all static bytes of the run is checked once
+ */
+int __generate_cxx_raw_run_begin( hcml_node_t *h, uint32_t node, uint32_t stop ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    uint32_t _n;
+    if ( h->raw_run_last != NULL ) return HCML_ERR_OK;
+    h->raw_run_left = 0;
+    for ( _n = node; _n != stop && _n != HCML_NODE_NONE && __cxx_is_raw_run_node(_t, _n); 
+        _n = _t->nodes[_n].next 
+    ) {
+        if ( !(_t->nodes[_n].flags & HCML_CNODE_TAG) ) h->raw_run_left += __cxx_static_string_size(_t, _n);
+        h->raw_run_last = _t->nodes + _n;
+    }
+    if ( h->raw_run_left > 0 ) {
+        hcml_append_code_format(h, 
+            "if ( (size_t)(hcml_end - hcml_cur) < %d ) %s(hcml_cur, hcml_end, %d);\n", 
+            h->raw_run_left, h->print_method, h->raw_run_left);
+    }
+    return h->errcode;
+}
+
+/* End the run after the last node */
+void __generate_cxx_raw_run_end( hcml_node_t *h, uint32_t node ) {
+    if ( h->raw_run_last == __cxx_table(h)->nodes + node ) h->raw_run_last = NULL;
+}
+
+/* 
+    Write the dynamic hcml_v in the scope, check the room with the 
+    static bytes left in the run
+ */
+int __generate_cxx_raw_write( hcml_node_t *h, int left ) {
+    if ( left > 0 ) {
+        hcml_append_code_format(h, 
+            "if ( (size_t)(hcml_end - hcml_cur) < hcml_v.size() + %d ) "
+            "%s(hcml_cur, hcml_end, hcml_v.size() + %d);\n", left, h->print_method, left);
+    } else {
+        hcml_append_code_format(h, 
+            "if ( (size_t)(hcml_end - hcml_cur) < hcml_v.size() ) "
+            "%s(hcml_cur, hcml_end, hcml_v.size());\n", h->print_method);
+    }
+    hcml_append_code_format(h, 
+        "memcpy(hcml_cur, hcml_v.data(), hcml_v.size());\nhcml_cur += hcml_v.size();");
+    __generate_cxx_probe_bytes(h, "hcml_v.size()");
+    hcml_append_code_format(h, "\n");
+    return h->errcode;
+}
+
+/* 
+    Generate the fragment cache, the body is rendered into a side buffer 
+    only when missing in the runtime cache 
+ */
+int __generate_cxx_cache( hcml_node_t *h, uint32_t node ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    struct hcml_prop_t _key_s, _ver_s, *_key, *_ver;
+    char _saved_method[sizeof(h->print_method)];
+    char _hit_size[64];
+    int _saved_method_l, _saved_mode, _seq;
+    const char *_name;
+    _key = __cxx_get_prop(_t, node, "key", &_key_s);
+    if ( _key == NULL || _key->vl == 0 ) {
+        hcml_set_error(h, HCML_ERR_ESYNTAX, 
+            "Syntax Error, missing key for cache at line: %d", (int)_t->nodes[node].bline);
+        return HCML_ERR_ESYNTAX;
+    }
+    _ver = __cxx_get_prop(_t, node, "version", &_ver_s);
+    _seq = h->site_seq++;
+    snprintf(_hit_size, sizeof(_hit_size), "hcml_fc_hit_%d->size()", _seq);
+    _name = hcml_current_name(h);
+
+    if ( !hcml_append_code_format(h, 
+        "{\nauto& hcml_fc_%d = hcml::rt::fragment_cache::local();\n"
+        "const std::string hcml_fc_key_%d = hcml::rt::fragment_cache::to_key(%.*s);\n"
+        "const unsigned long long hcml_fc_ver_%d = (%.*s);\n"
+        "auto hcml_fc_hit_%d = hcml_fc_%d.find(\"", 
+        _seq, _seq, _key->vl, _key->value, _seq, 
+        (_ver == NULL || _ver->vl == 0 ? 1 : _ver->vl), 
+        (_ver == NULL || _ver->vl == 0 ? "0" : _ver->value), _seq, _seq) 
+    ) return h->errcode;
+    hcml_append_escaped_string(h, _name, (int)strlen(_name));
+    if ( !hcml_append_code_format(h, ":%d\", hcml_fc_key_%d, hcml_fc_ver_%d);\n"
+        "if ( !hcml_fc_hit_%d ) {\nhcml::rt::fragment_buffer hcml_fc_buf_%d;\n",
+        (int)_t->nodes[node].bline, _seq, _seq, _seq, _seq)
+    ) return h->errcode;
+
+    /* Render the body with the side buffer, always in print mode */
+    if ( _t->nodes[node].child != HCML_NODE_NONE ) {
+        memcpy(_saved_method, h->print_method, sizeof(_saved_method));
+        _saved_method_l = h->print_method_l;
+        _saved_mode = h->render_mode;
+        h->print_method_l = snprintf(h->print_method, sizeof(h->print_method), 
+            "hcml_fc_buf_%d.write", _seq);
+        h->render_mode = HCML_RENDER_PRINT;
+        ++h->cache_depth;
+        hcml_generate_cxx_nodes(h, _t->nodes[node].child, HCML_NODE_NONE, "\n");
+        --h->cache_depth;
+        memcpy(h->print_method, _saved_method, sizeof(_saved_method));
+        h->print_method_l = _saved_method_l;
+        h->render_mode = _saved_mode;
+        if ( h->errcode != HCML_ERR_OK ) return h->errcode;
+    }
+
+    if ( !hcml_append_code_format(h, "hcml_fc_hit_%d = hcml_fc_%d.store(\"", _seq, _seq) ) 
+        return h->errcode;
+    hcml_append_escaped_string(h, _name, (int)strlen(_name));
+    if ( !hcml_append_code_format(h, 
+        ":%d\", hcml_fc_key_%d, hcml_fc_ver_%d, hcml_fc_buf_%d.release());\n}\n",
+        (int)_t->nodes[node].bline, _seq, _seq, _seq)
+    ) return h->errcode;
+    if ( h->render_mode == HCML_RENDER_COROUTINE ) {
+        /* The shared data keeps alive during the suspension */
+        if ( !hcml_append_code_format(h, 
+            "co_yield std::string_view(hcml_fc_hit_%d->data(), hcml_fc_hit_%d->size());", 
+            _seq, _seq) 
+        ) return h->errcode;
+        if ( HCML_ERR_OK != __generate_cxx_probe_bytes(h, _hit_size) ) return h->errcode;
+        if ( !hcml_append_code_format(h, "\n}") ) return h->errcode;
+    } else if ( h->render_mode == HCML_RENDER_RAWBUF ) {
+        if ( !hcml_append_code_format(h, "{\nhcml::rt::raw_view hcml_v(*hcml_fc_hit_%d);\n", _seq) ) 
+            return h->errcode;
+        if ( HCML_ERR_OK != __generate_cxx_raw_write(h, 0) ) return h->errcode;
+        if ( !hcml_append_code_format(h, "}\n}") ) return h->errcode;
+    } else {
+        if ( !hcml_append_code_format(h, 
+            "%s(hcml_fc_hit_%d->data(), hcml_fc_hit_%d->size());", 
+            h->print_method, _seq, _seq) 
+        ) return h->errcode;
+        if ( HCML_ERR_OK != __generate_cxx_probe_bytes(h, _hit_size) ) return h->errcode;
+        if ( !hcml_append_code_format(h, "\n}") ) return h->errcode;
+    }
+    return HCML_ERR_OK;
+}
+
+/* Generate the #line directive of the statement */
+int __generate_cxx_line_directive( hcml_node_t *h, int bline ) {
+    const char *_name = hcml_current_name(h);
+    /* A directive must start a line */
+    if ( h->rsize > 0 && h->presult[h->rsize - 1] != '\n' ) {
+        if ( !hcml_append_code_format(h, "\n") ) return h->errcode;
+    }
+    if ( !hcml_append_code_format(h, "#line %d \"", bline) ) return h->errcode;
+    hcml_append_escaped_string(h, _name, (int)strlen(_name));
+    hcml_append_code_format(h, "\"\n");
+    h->line_in_template = 1;
+    return h->errcode;
+}
+
+/* Make the name of the generated file for the #line directives back to it */
+int hcml_prepare_cxx_lines( hcml_node_t *h ) {
+    const char *_name = (h->line_output != NULL ? h->line_output : h->src_name);
+    int _begin = h->rsize;
+    /* Escaped at the end of the output, then taken out */
+    hcml_append_escaped_string(h, _name, (int)strlen(_name));
+    if ( h->line_output == NULL ) hcml_append_code_format(h, ".inc");
+    if ( h->errcode != HCML_ERR_OK ) return h->errcode;
+    __hcml_free(h->line_return);
+    h->line_return = (char *)__hcml_malloc(h->rsize - _begin + 1);
+    if ( h->line_return == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Line Directive");
+        return h->errcode;
+    }
+    memcpy(h->line_return, h->presult + _begin, h->rsize - _begin);
+    h->line_return[h->rsize - _begin] = '\0';
+    h->rsize = _begin;
+    h->presult[h->rsize] = '\0';
+    h->line_in_template = 0;
+    return HCML_ERR_OK;
+}
+
+/* 
+    Generate the #line directive back to the generated file, the number is
+    set by hcml_sync_cxx_lines after the code is in place
+ */
+int __generate_cxx_line_return( hcml_node_t *h ) {
+    if ( h->rsize > 0 && h->presult[h->rsize - 1] != '\n' ) {
+        if ( !hcml_append_code_format(h, "\n") ) return h->errcode;
+    }
+    hcml_append_code_format(h, "#line 1 \"%s\"\n", h->line_return);
+    h->line_in_template = 0;
+    return h->errcode;
+}
+
+/* Length of the directive back to the generated file at the line, or 0 */
+int __cxx_line_return_length( hcml_node_t *h, const char *s, int l ) {
+    int _i = 6, _nl = (int)strlen(h->line_return);
+    if ( l < 6 || strncmp(s, "#line ", 6) != 0 ) return 0;
+    while ( _i < l && s[_i] >= '0' && s[_i] <= '9' ) ++_i;
+    if ( _i == 6 || _i + _nl + 4 > l || s[_i] != ' ' || s[_i + 1] != '"' ) return 0;
+    if ( strncmp(s + _i + 2, h->line_return, _nl) != 0 ) return 0;
+    if ( s[_i + 2 + _nl] != '"' || s[_i + 3 + _nl] != '\n' ) return 0;
+    return _i + _nl + 4;
+}
+
+/* Number the directives back to the generated file in the buffer, the buffer is replaced */
+int __cxx_sync_line_buffer( hcml_node_t *h, char **buf, int *size, int *bufsize ) {
+    char *_out;
+    int _i, _o, _l, _line, _count, _alloc;
+    if ( *buf == NULL || *size == 0 ) return HCML_ERR_OK;
+    for ( _i = 0, _count = 0; _i < *size; ++_i ) {
+        if ( (_i == 0 || (*buf)[_i - 1] == '\n') && (*buf)[_i] == '#' ) ++_count;
+    }
+    if ( _count == 0 ) return HCML_ERR_OK;
+    /* A number is at most 10 digits */
+    _alloc = *size + _count * 10 + 1;
+    _out = (char *)__hcml_malloc(_alloc);
+    if ( _out == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Line Directive");
+        return h->errcode;
+    }
+    for ( _i = 0, _o = 0, _line = 1; _i < *size; ++_line ) {
+        _l = __cxx_line_return_length(h, *buf + _i, *size - _i);
+        if ( _l > 0 ) {
+            _o += sprintf(_out + _o, "#line %d \"%s\"\n", _line + 1, h->line_return);
+            _i += _l;
+            continue;
+        }
+        while ( _i < *size && (*buf)[_i] != '\n' ) _out[_o++] = (*buf)[_i++];
+        if ( _i < *size ) _out[_o++] = (*buf)[_i++];
+    }
+    _out[_o] = '\0';
+    __hcml_free(*buf);
+    *buf = _out;
+    *size = _o;
+    *bufsize = _alloc;
+    return HCML_ERR_OK;
+}
+
+/* Number the #line directives back to the generated file as their next line */
+int hcml_sync_cxx_lines( hcml_node_t *h ) {
+    int _i;
+    if ( HCML_ERR_OK != __cxx_sync_line_buffer(h, &h->presult, &h->rsize, &h->bufsize) ) 
+        return h->errcode;
+    for ( _i = 0; h->outline_count > 0 && _i < h->outline_alloc; ++_i ) {
+        if ( HCML_ERR_OK != __cxx_sync_line_buffer(h, &h->outlines[_i].code, 
+            &h->outlines[_i].size, &h->outlines[_i].bufsize) 
+        ) return h->errcode;
+    }
+    return HCML_ERR_OK;
+}
+
 /* Generate Code Wrapper */
 int __generate_cxx_wrapper( 
-    hcml_node_t *h, struct hcml_tag_t *root_tag,
+    hcml_node_t *h, uint32_t node,
     const char *begin, const char* end, const char* suf 
 ) {
+    uint32_t _c = __cxx_table(h)->nodes[node].child;
     do {
         if ( !hcml_append_code_format(h, begin ) ) break;
-        if ( root_tag->c_tag == NULL ) {
+        if ( _c == HCML_NODE_NONE ) {
             hcml_set_error(h, HCML_ERR_ESYNTAX, 
                 "Syntax Error, empty wrapper %s%s", begin, end);
             break;
         }
-        if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, suf) ) break;
+        if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _c, HCML_NODE_NONE, suf) ) break;
         if ( !hcml_append_code_format(h, end) ) break;
     } while ( 0 );
     return h->errcode;
 }
 
-/* Genearte C++ Code according to the parsed tag */
-int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const char*suf ) {
+int __cxx_is_exact_tag( const struct hcml_node_table_t *t, uint32_t node, const char *tagname );
+
+/* 
+    Static bytes printed by every run of the statement list, nodes
+    inside condition, loop or cache are not counted
+ */
+int __cxx_static_body_size( hcml_node_t *h, uint32_t node ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    struct hcml_prop_t _src;
+    struct hcml_include_t *_inc, *_saved_inc;
+    int _size = 0;
+    for ( ; node != HCML_NODE_NONE; node = _t->nodes[node].next ) {
+        if ( !(_t->nodes[node].flags & HCML_CNODE_TAG) ) {
+            _size += __cxx_static_string_size(_t, node);
+        } else if ( __cxx_is_exact_tag(_t, node, "block") ) {
+            _size += __cxx_static_body_size(h, _t->nodes[node].child);
+        } else if ( __cxx_is_exact_tag(_t, node, "include") ) {
+            if ( __cxx_get_prop(_t, node, "src", &_src) == NULL ) continue;
+            _inc = hcml_load_include(h, _src.value, _src.vl, (int)_t->nodes[node].bline);
+            if ( _inc == NULL ) return 0;
+            if ( _inc->root == HCML_NODE_NONE ) continue;
+            _saved_inc = h->cur_inc;
+            h->cur_inc = _inc;
+            if ( !h->is_worker ) _inc->busy = 1;
+            _size += __cxx_static_body_size(h, _inc->root);
+            if ( !h->is_worker ) _inc->busy = 0;
+            h->cur_inc = _saved_inc;
+        }
+    }
+    return _size;
+}
+
+/* Find the schema by name, or the schema the variable is bound to */
+struct hcml_schema_t *__cxx_find_schema( 
+    hcml_node_t *h, const char *name, int nl, int is_var 
+) {
+    struct hcml_schema_t *_s;
+    for ( _s = h->schemas; _s != NULL; _s = _s->n_schema ) {
+        if ( (_s->bound != NULL) != is_var || _s->nl != nl ) continue;
+        if ( strncmp(_s->name, name, nl) != 0 ) continue;
+        return is_var ? _s->bound : _s;
+    }
+    return NULL;
+}
+
+/* Add a schema, or bind the variable to the schema */
+int __cxx_add_schema( 
+    hcml_node_t *h, const char *name, int nl, 
+    struct hcml_node_table_t *table, uint32_t node, struct hcml_schema_t *bound 
+) {
+    struct hcml_schema_t *_s;
+    _s = (struct hcml_schema_t *)__hcml_malloc(sizeof(struct hcml_schema_t));
+    if ( _s == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Schema");
+        return h->errcode;
+    }
+    _s->name = name;
+    _s->nl = nl;
+    _s->table = table;
+    _s->node = node;
+    _s->bound = bound;
+    _s->n_schema = h->schemas;
+    h->schemas = _s;
+    return HCML_ERR_OK;
+}
+
+/* 
+    Declare the schema, every child is a cxx:field mapping a key to a member 
+    or an index. The variables in property `var` are bound to it
+ */
+int __generate_cxx_schema( hcml_node_t *h, uint32_t node ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    struct hcml_prop_t _name, _var, _p;
+    uint32_t _f;
+    int _i, _b;
+    if ( __cxx_get_prop(_t, node, "name", &_name) == NULL || _name.vl == 0 ) {
+        hcml_set_error(h, HCML_ERR_ESYNTAX, 
+            "Syntax Error, missing name for schema at line: %d", (int)_t->nodes[node].bline);
+        return HCML_ERR_ESYNTAX;
+    }
+    for ( _f = _t->nodes[node].child; _f != HCML_NODE_NONE; _f = _t->nodes[_f].next ) {
+        if ( !__cxx_is_exact_tag(_t, _f, "field") || __cxx_get_prop(_t, _f, "key", &_p) == NULL || 
+            (__cxx_get_prop(_t, _f, "member", &_p) == NULL) == 
+            (__cxx_get_prop(_t, _f, "index", &_p) == NULL) 
+        ) {
+            hcml_set_error(h, HCML_ERR_ESYNTAX, 
+                "Syntax Error, a field needs key and one of member or index at line: %d", 
+                (int)_t->nodes[_f].bline);
+            return HCML_ERR_ESYNTAX;
+        }
+    }
+    if ( HCML_ERR_OK != __cxx_add_schema(h, _name.value, _name.vl, _t, node, NULL) ) 
+        return h->errcode;
+    if ( __cxx_get_prop(_t, node, "var", &_var) == NULL ) return HCML_ERR_OK;
+    /* Variable names are split by space or comma */
+    for ( _i = 0; _i < _var.vl; ) {
+        while ( _i < _var.vl && (_var.value[_i] == ' ' || _var.value[_i] == ',') ) ++_i;
+        for ( _b = _i; _i < _var.vl && _var.value[_i] != ' ' && _var.value[_i] != ','; ++_i );
+        if ( _i == _b ) break;
+        if ( HCML_ERR_OK != __cxx_add_schema(h, _var.value + _b, _i - _b, NULL, 
+            HCML_NODE_NONE, h->schemas) 
+        ) return h->errcode;
+    }
+    return HCML_ERR_OK;
+}
+
+int __cxx_fold_unescape( const char *s, int l, char *out );
+
+/* Get the constant key of a subscript, the only child is a cxx:string */
+int __cxx_subscript_key( 
+    hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node, const char **key 
+) {
+    uint32_t _s, _c;
+    if ( !__cxx_is_exact_tag(t, node, "subscript") || __find_node_tag(h, t, node) != NULL ) 
+        return -1;
+    _s = t->nodes[node].child;
+    if ( _s == HCML_NODE_NONE || t->nodes[_s].next != HCML_NODE_NONE || 
+        !__cxx_is_exact_tag(t, _s, "string") 
+    ) return -1;
+    _c = t->nodes[_s].child;
+    if ( _c == HCML_NODE_NONE ) {
+        *key = "";
+        return 0;
+    }
+    if ( (t->nodes[_c].flags & HCML_CNODE_TAG) || t->nodes[_c].next != HCML_NODE_NONE ) return -1;
+    *key = __cxx_data(t, _c);
+    return (int)t->nodes[_c].data_len;
+}
+
+/* 
+    Generate the constant key of the subscript as the key type, carrying the
+    length and the hash of the unescaped key. Return 0 if not constant
+ */
+int __generate_cxx_hashed_key( hcml_node_t *h, uint32_t node, int *done ) {
+    const char *_k;
+    char *_raw;
+    int _kl, _rl;
+    unsigned long long _hash;
+    *done = 0;
+    _kl = __cxx_subscript_key(h, __cxx_table(h), node, &_k);
+    if ( _kl < 0 ) return HCML_ERR_OK;
+    _raw = (char *)__hcml_malloc(_kl + 1);
+    if ( _raw == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Subscript Key");
+        return h->errcode;
+    }
+    _rl = __cxx_fold_unescape(_k, _kl, _raw);
+    if ( _rl >= 0 ) {
+        _hash = (h->key_hash != NULL ? (*h->key_hash)(_raw, _rl) : __hash_fnv1a(_raw, _rl));
+        hcml_append_code_format(h, "[%s(\"%.*s\", %d, 0x%016llxULL)]", 
+            h->key_type, _kl, _k, _rl, _hash);
+        *done = 1;
+    }
+    __hcml_free(_raw);
+    return h->errcode;
+}
+
+/* 
+    Generate the subscripts of a schema-bound variable, every constant key is
+    turned into the member or the index of the field. Once a field has no 
+    schema, or the key is not constant, the rest are generated as is
+ */
+int __generate_cxx_schema_access( 
+    hcml_node_t *h, uint32_t node, struct hcml_schema_t *schema 
+) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    const struct hcml_node_table_t *_st;
+    uint32_t _f;
+    struct hcml_prop_t _key, _p;
+    const char *_k;
+    int _kl;
+    for ( ; node != HCML_NODE_NONE && schema != NULL; node = _t->nodes[node].next ) {
+        _kl = __cxx_subscript_key(h, _t, node, &_k);
+        if ( _kl < 0 ) break;
+        _st = schema->table;
+        for ( _f = _st->nodes[schema->node].child; _f != HCML_NODE_NONE; _f = _st->nodes[_f].next ) {
+            __cxx_get_prop(_st, _f, "key", &_key);
+            if ( _key.vl == _kl && strncmp(_key.value, _k, _kl) == 0 ) break;
+        }
+        if ( _f == HCML_NODE_NONE ) {
+            hcml_set_error(h, HCML_ERR_ESYNTAX, 
+                "Schema Error, no key \"%.*s\" in schema %.*s at line: %d", 
+                _kl, _k, schema->nl, schema->name, (int)_t->nodes[node].bline);
+            return HCML_ERR_ESYNTAX;
+        }
+        if ( __cxx_get_prop(_st, _f, "member", &_p) != NULL ) {
+            /* A member begins with -> is accessed through a pointer */
+            if ( !hcml_append_code_format(h, "%s%.*s", 
+                (_p.vl > 1 && _p.value[0] == '-' && _p.value[1] == '>' ? "" : "."), 
+                _p.vl, _p.value) 
+            ) return h->errcode;
+        } else {
+            __cxx_get_prop(_st, _f, "index", &_p);
+            if ( !hcml_append_code_format(h, "[%.*s]", _p.vl, _p.value) ) return h->errcode;
+        }
+        if ( __cxx_get_prop(_st, _f, "schema", &_p) == NULL ) {
+            schema = NULL;
+        } else if ( (schema = __cxx_find_schema(h, _p.value, _p.vl, 0)) == NULL ) {
+            hcml_set_error(h, HCML_ERR_ESYNTAX, 
+                "Schema Error, unknown schema %.*s at line: %d", _p.vl, _p.value, 
+                (int)_st->nodes[_f].bline);
+            return HCML_ERR_ESYNTAX;
+        }
+    }
+    if ( node != HCML_NODE_NONE ) hcml_generate_cxx_nodes(h, node, HCML_NODE_NONE, NULL);
+    return h->errcode;
+}
+
+/* 
+    Genearte C++ Code of the node, the sibling list stops before stop.
+    Return 0 if the generation of the list must stop
+ */
+int __generate_cxx_node( hcml_node_t *h, uint32_t node, uint32_t stop, const char*suf ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    const struct hcml_cnode_t *_n = _t->nodes + node;
+    struct hcml_prop_t _prop, _eol, _result, _getval, _getaddr, _getref, _pschema;
     struct hcml_prop_t * __prop = NULL;
     struct hcml_prop_t * __peol = NULL;
     struct hcml_prop_t * __presult = NULL;
     struct hcml_prop_t * __pgetval = NULL;
     struct hcml_prop_t * __pgetaddr = NULL;
     struct hcml_prop_t * __pgetref = NULL;
+    struct hcml_prop_t * __pschema = NULL;
+    struct hcml_schema_t * __schema = NULL;
+    const struct hcml_tag_entry_t * __entry = NULL;
+    struct hcml_tag_t * __view = NULL;
+    int _last = ( _n->next == stop || _n->next == HCML_NODE_NONE );
+    int _done = 0;
     int _pure_string_size = 0;
+    int _suf_appended = 0;
+    int _key_done = 0;
+    char _probe_size[16];
     do {
-        if ( root_tag->is_tag == 0 ) {
-            if ( !hcml_append_code_format(h, "%s(\"", h->print_method) ) break;
-            _pure_string_size = hcml_append_pure_string(h, root_tag->data_string, root_tag->dl);
-            if ( _pure_string_size == 0 ) break;
-            if ( !hcml_append_code_format(h, "\", %d);", _pure_string_size) ) break;
+        /* Only statement list is generated with a new line suffix */
+        if ( h->line_directives && suf != NULL && suf[0] == '\n' && (int)_n->bline > 0 && 
+            !__cxx_is_exact_tag(_t, node, "include") 
+        ) {
+            if ( HCML_ERR_OK != __generate_cxx_line_directive(h, (int)_n->bline) ) break;
+        }
+        if ( !(_n->flags & HCML_CNODE_TAG) ) {
+            if ( h->is_static && _n->parent == HCML_NODE_NONE && _n->next == HCML_NODE_NONE ) {
+                _pure_string_size = __generate_cxx_static_template(h, __cxx_data(_t, node), (int)_n->data_len);
+                if ( _pure_string_size < 0 ) break;
+            } else {
+                if ( h->render_mode == HCML_RENDER_COROUTINE ) {
+                    if ( !hcml_append_code_format(h, "co_yield std::string_view(\"") ) break;
+                } else if ( h->render_mode == HCML_RENDER_RAWBUF ) {
+                    if ( HCML_ERR_OK != __generate_cxx_raw_run_begin(h, node, stop) ) break;
+                    if ( !hcml_append_code_format(h, "memcpy(hcml_cur, \"") ) break;
+                } else {
+                    if ( !hcml_append_code_format(h, "%s(\"", h->print_method) ) break;
+                }
+                if ( _n->flags & HCML_CNODE_FOLDED ) {
+                    _pure_string_size = hcml_append_escaped_string(h, __cxx_data(_t, node), (int)_n->data_len);
+                } else {
+                    _pure_string_size = hcml_append_pure_string(h, __cxx_data(_t, node), (int)_n->data_len);
+                }
+                if ( _pure_string_size == 0 ) break;
+                if ( h->render_mode == HCML_RENDER_RAWBUF ) {
+                    if ( !hcml_append_code_format(h, "\", %d);\nhcml_cur += %d;", 
+                        _pure_string_size, _pure_string_size) ) break;
+                    h->raw_run_left -= _pure_string_size;
+                    __generate_cxx_raw_run_end(h, node);
+                } else {
+                    if ( !hcml_append_code_format(h, "\", %d);", _pure_string_size) ) break;
+                }
+                snprintf(_probe_size, sizeof(_probe_size), "%d", _pure_string_size);
+                if ( HCML_ERR_OK != __generate_cxx_probe_bytes(h, _probe_size) ) break;
+            }
+            /* Auto flush only in statement list, and never inside a loop */
+            h->flush_pending += _pure_string_size;
+            if ( h->flush_threshold > 0 && 
+                ( h->flush_method_l > 0 || h->render_mode == HCML_RENDER_COROUTINE ) && 
+                h->flush_pending >= h->flush_threshold &&
+                h->raw_run_last == NULL &&
+                __cxx_is_flushable_statement(_t, node)
+            ) {
+                if ( h->line_in_template ) {
+                    if ( HCML_ERR_OK != __generate_cxx_line_return(h) ) break;
+                }
+                if ( HCML_ERR_OK != __generate_cxx_flush(h, (int)_n->bline) ) break;
+            }
         } else {
-            __peol = __cxx_get_prop(root_tag, "eol");
-            __pgetval = __cxx_get_prop(root_tag, "val");
-            __pgetaddr = __cxx_get_prop(root_tag, "addr");
-            __pgetref = __cxx_get_prop(root_tag, "ref");
+            __peol = __cxx_get_prop(_t, node, "eol", &_eol);
+            __pgetval = __cxx_get_prop(_t, node, "val", &_getval);
+            __pgetaddr = __cxx_get_prop(_t, node, "addr", &_getaddr);
+            __pgetref = __cxx_get_prop(_t, node, "ref", &_getref);
 
-            if ( __cxx_is_tag(root_tag, "string") ) {
+            if ( (__entry = __find_node_tag(h, _t, node)) != NULL ) {
+                if ( (__view = hcml_get_node_view(h, (int)node)) == NULL ) break;
+                if ( HCML_ERR_OK != (*__entry->fn)(h, __view, suf, __entry->userdata) ) break;
+            } else if ( __cxx_is_tag(_t, node, "string") ) {
                 if ( !hcml_append_code_format(h, "\"") ) break;
-                if ( root_tag->c_tag != NULL ) {
+                if ( _n->child != HCML_NODE_NONE ) {
                     // String Tag is an atomic tag, all data insider will be wraped
                     // by quote
                     if ( !hcml_append_code_format(h, "%.*s", 
-                        root_tag->c_tag->dl, root_tag->c_tag->data_string)
+                        (int)_t->nodes[_n->child].data_len, __cxx_data(_t, _n->child))
                     ) {
                         break;                    
                     }
                 }
                 if ( !hcml_append_code_format(h, "\"") ) break;
-            } else if ( __cxx_is_tag(root_tag, "const") ) {
-                if ( root_tag->c_tag == NULL ) {
+            } else if ( __cxx_is_tag(_t, node, "const") ) {
+                if ( _n->child == HCML_NODE_NONE ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error, invalid const tag");
                     break;
                 }
                 if ( !hcml_append_code_format(h, "%.*s", 
-                    root_tag->c_tag->dl, root_tag->c_tag->data_string)
+                    (int)_t->nodes[_n->child].data_len, __cxx_data(_t, _n->child))
                 ) {
                     break;
                 }
-            } else if ( __cxx_is_tag(root_tag, "empty") ) {
+            } else if ( __cxx_is_tag(_t, node, "empty") ) {
                 /* Do nothing for empty tag */
-            } else if ( __cxx_is_tag(root_tag, "invoke") ) {
-                __prop = __cxx_get_prop(root_tag, "ptr");
+            } else if ( __cxx_is_tag(_t, node, "schema") ) {
+                /* Declaration only, nothing is generated */
+                if ( HCML_ERR_OK != __generate_cxx_schema(h, node) ) break;
+                _suf_appended = 1;
+            } else if ( __cxx_is_tag(_t, node, "invoke") ) {
+                __prop = __cxx_get_prop(_t, node, "ptr", &_prop);
                 if ( __prop != NULL ) {
                     if ( !hcml_append_code_format(h, "->") ) break;
                 } else {
                     if ( !hcml_append_code_format(h, ".") ) break;
                 }
-                __prop = __cxx_get_prop(root_tag, "name");
+                __prop = __cxx_get_prop(_t, node, "name", &_prop);
                 if ( __prop == NULL ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error, missing function name for invoke.");
@@ -218,28 +1027,28 @@ int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const c
                 }
 
                 if ( !hcml_append_code_format(h, "%.*s(", __prop->vl, __prop->value) ) break;
-                if ( root_tag->c_tag != NULL ) {
-                    if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, ", ") ) break;
+                if ( _n->child != HCML_NODE_NONE ) {
+                    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, ", ") ) break;
                     h->rsize -= 2;
                 }
                 if ( !hcml_append_code_format(h, ")" ) ) break;
-            } else if ( __cxx_is_tag(root_tag, "call") ) {
-                __prop = __cxx_get_prop(root_tag, "name");
+            } else if ( __cxx_is_tag(_t, node, "call") ) {
+                __prop = __cxx_get_prop(_t, node, "name", &_prop);
                 if ( __prop == NULL ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error, missing function name for call.");
                     break;
                 }
 
-                __presult = __cxx_get_prop(root_tag, "result");
+                __presult = __cxx_get_prop(_t, node, "result", &_result);
                 if ( __presult != NULL ) {
                     if ( !hcml_append_code_format(h, "auto %.*s = ", __presult->vl, __presult->value) ) 
                         break;
                 }
 
                 if ( !hcml_append_code_format(h, "%.*s(", __prop->vl, __prop->value) ) break;
-                if ( root_tag->c_tag != NULL ) {
-                    if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, ", ") ) break;
+                if ( _n->child != HCML_NODE_NONE ) {
+                    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, ", ") ) break;
                     h->rsize -= 2;
                 }
                 if ( !hcml_append_code_format(h, ")" ) ) break;
@@ -248,19 +1057,19 @@ int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const c
                     if ( !hcml_append_code_format(h, ";") ) break;
                 }
 
-            } else if ( __cxx_is_tag(root_tag, "list") ) {
+            } else if ( __cxx_is_tag(_t, node, "list") ) {
                 if ( !hcml_append_code_format(h, "{") ) break;
-                if ( root_tag->c_tag != NULL ) {
-                    if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, ", ") ) break;
+                if ( _n->child != HCML_NODE_NONE ) {
+                    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, ", ") ) break;
                     h->rsize -= 2;
                 }
                 if ( !hcml_append_code_format(h, "}" ) ) break;
-            } else if ( __cxx_is_tag(root_tag, "var") ) {
-                __prop = __cxx_get_prop(root_tag, "type");
+            } else if ( __cxx_is_tag(_t, node, "var") ) {
+                __prop = __cxx_get_prop(_t, node, "type", &_prop);
                 if ( __prop != NULL ) {
                     if ( !hcml_append_code_format(h, "%.*s ", __prop->vl, __prop->value) ) break;
                 }
-                __prop = __cxx_get_prop(root_tag, "name");
+                __prop = __cxx_get_prop(_t, node, "name", &_prop);
                 if ( __prop == NULL ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error, missing variable name for var.");
@@ -273,88 +1082,148 @@ int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const c
                 } else {
                     if ( !hcml_append_code_format(h, "%.*s", __prop->vl, __prop->value) ) break;
                 }
-                if ( root_tag->c_tag != NULL ) {
-                    if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, NULL) ) break;
+                /* Bind the variable to the schema from here on */
+                __schema = NULL;
+                if ( (__pschema = __cxx_get_prop(_t, node, "schema", &_pschema)) != NULL ) {
+                    __schema = __cxx_find_schema(h, __pschema->value, __pschema->vl, 0);
+                    if ( __schema == NULL ) {
+                        hcml_set_error(h, HCML_ERR_ESYNTAX, 
+                            "Schema Error, unknown schema %.*s at line: %d", 
+                            __pschema->vl, __pschema->value, (int)_n->bline);
+                        break;
+                    }
+                    if ( HCML_ERR_OK != __cxx_add_schema(h, __prop->value, __prop->vl, NULL, HCML_NODE_NONE, __schema) ) 
+                        break;
+                } else if ( h->schemas != NULL ) {
+                    __schema = __cxx_find_schema(h, __prop->value, __prop->vl, 1);
                 }
-            } else if ( __cxx_is_tag(root_tag, "code") ) {
-                if ( root_tag->c_tag == NULL ) {
+                if ( __schema != NULL ) {
+                    if ( HCML_ERR_OK != __generate_cxx_schema_access(h, _n->child, __schema) ) 
+                        break;
+                } else if ( _n->child != HCML_NODE_NONE ) {
+                    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, NULL) ) break;
+                }
+            } else if ( __cxx_is_tag(_t, node, "code") ) {
+                if ( _n->child == HCML_NODE_NONE ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error, invalid code tag");
                     break;
                 }
                 if ( !hcml_append_code_format(h, "%.*s", 
-                    root_tag->c_tag->dl, root_tag->c_tag->data_string)
+                    (int)_t->nodes[_n->child].data_len, __cxx_data(_t, _n->child))
                 ) {
                     break;
                 }
-            } else if ( __cxx_is_tag(root_tag, "line") ) {
-                if ( root_tag->c_tag != NULL ) {
-                    if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "line") ) {
+                if ( _n->child != HCML_NODE_NONE ) {
+                    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, NULL) ) break;
                 }
                 if ( !hcml_append_code_format(h, ";") ) break;
-            } else if ( __cxx_is_tag(root_tag, "print")) {
-                if ( !hcml_append_code_format(h, "%s(", h->print_method) ) break;
-                if ( root_tag->c_tag == NULL ) {
+            } else if ( __cxx_is_tag(_t, node, "print")) {
+                if ( h->render_mode == HCML_RENDER_COROUTINE ) {
+                    if ( !hcml_append_code_format(h, "co_yield ") ) break;
+                    if ( __cxx_has_probe(h) && !hcml_append_code_format(h, "hcml::rt::probe_write(") ) break;
+                } else if ( h->render_mode == HCML_RENDER_RAWBUF ) {
+                    if ( HCML_ERR_OK != __generate_cxx_raw_run_begin(h, node, stop) ) break;
+                    if ( !hcml_append_code_format(h, "{\nhcml::rt::raw_view hcml_v(") ) break;
+                } else {
+                    if ( !hcml_append_code_format(h, "%s(", h->print_method) ) break;
+                    if ( __cxx_has_probe(h) && !hcml_append_code_format(h, "hcml::rt::probe_write(") ) break;
+                }
+                if ( _n->child == HCML_NODE_NONE ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: Empty print is not allowed");
                     break;
                 }
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, NULL) ) break;
-                if ( !hcml_append_code_format(h, ");") ) break;
-            } else if ( __cxx_is_tag(root_tag, "subscript") ) {
-                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, root_tag, "[", "]", NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "block") ) {
-                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, root_tag, "{\n", "}", "\n") ) break;
-            } else if ( __cxx_is_tag(root_tag, "parentheses") ) {
-                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, root_tag, "(", ")", NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "post_increase") ) {
-                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, root_tag, "", "++", NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "pre_increase") ) {
-                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, root_tag, "++", "", NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "post_decrease") ) {
-                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, root_tag, "", "--", NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "pre_decrease") ) {
-                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, root_tag, "--", "", NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "set") ) {
-                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, root_tag, "=") ) break;
-            } else if ( __cxx_is_tag(root_tag, "great") ) {
-                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, root_tag, ">") ) break;
-            } else if ( __cxx_is_tag(root_tag, "greatequal") ) {
-                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, root_tag, ">=") ) break;
-            } else if ( __cxx_is_tag(root_tag, "less") ) {
-                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, root_tag, "<") ) break;
-            } else if ( __cxx_is_tag(root_tag, "lessequan") ) {
-                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, root_tag, "<=") ) break;
-            } else if ( __cxx_is_tag(root_tag, "equal") ) {
-                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, root_tag, "==") ) break;
-            } else if ( __cxx_is_tag(root_tag, "notequal") ) {
-                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, root_tag, "!=") ) break;
-            } else if ( __cxx_is_tag(root_tag, "plus") ) {
-                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, root_tag, "+") ) break;
-            } else if ( __cxx_is_tag(root_tag, "minus") ) {
-                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, root_tag, "-") ) break;
-            } else if ( __cxx_is_tag(root_tag, "times") ) {
-                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, root_tag, "*") ) break;
-            } else if ( __cxx_is_tag(root_tag, "divid") ) {
-                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, root_tag, "/") ) break;
-            } else if ( __cxx_is_tag(root_tag, "mod") ) {
-                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, root_tag, "%") ) break;
-            } else if ( __cxx_is_tag(root_tag, "return") ) {
+                if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, NULL) ) break;
+                if ( __cxx_has_probe(h) && h->render_mode != HCML_RENDER_RAWBUF ) {
+                    if ( !hcml_append_code_format(h, ")") ) break;
+                }
+                if ( h->render_mode == HCML_RENDER_COROUTINE ) {
+                    if ( !hcml_append_code_format(h, ";") ) break;
+                } else if ( h->render_mode == HCML_RENDER_RAWBUF ) {
+                    if ( !hcml_append_code_format(h, ");\n") ) break;
+                    if ( HCML_ERR_OK != __generate_cxx_raw_write(h, h->raw_run_left) ) break;
+                    if ( !hcml_append_code_format(h, "}") ) break;
+                    __generate_cxx_raw_run_end(h, node);
+                } else {
+                    if ( !hcml_append_code_format(h, ");") ) break;
+                }
+            } else if ( __cxx_is_tag(_t, node, "flush") ) {
+                if ( HCML_ERR_OK != __generate_cxx_flush(h, (int)_n->bline) ) break;
+            } else if ( __cxx_is_tag(_t, node, "include") ) {
+                /* Every included node has been appended the suffix */
+                if ( HCML_ERR_OK != __generate_cxx_include(h, node, suf) ) break;
+                _suf_appended = 1;
+            } else if ( __cxx_is_tag(_t, node, "cache") ) {
+                if ( HCML_ERR_OK != __generate_cxx_cache(h, node) ) break;
+            } else if ( __cxx_is_tag(_t, node, "subscript") ) {
+                _key_done = 0;
+                if ( h->key_type_l > 0 ) {
+                    if ( HCML_ERR_OK != __generate_cxx_hashed_key(h, node, &_key_done) ) break;
+                }
+                if ( !_key_done ) {
+                    if ( HCML_ERR_OK != __generate_cxx_wrapper(h, node, "[", "]", NULL) ) break;
+                }
+            } else if ( __cxx_is_tag(_t, node, "block") ) {
+                if ( _n->parent == HCML_NODE_NONE && __cxx_has_probe(h) && _n->child != HCML_NODE_NONE ) {
+                    if ( !hcml_append_code_format(h, "{\n") ) break;
+                    if ( HCML_ERR_OK != __generate_cxx_probe(h, (int)_n->bline, "block") ) break;
+                    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, "\n") ) break;
+                    if ( !hcml_append_code_format(h, "}") ) break;
+                } else {
+                    if ( HCML_ERR_OK != __generate_cxx_wrapper(h, node, "{\n", "}", "\n") ) break;
+                }
+            } else if ( __cxx_is_tag(_t, node, "parentheses") ) {
+                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, node, "(", ")", NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "post_increase") ) {
+                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, node, "", "++", NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "pre_increase") ) {
+                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, node, "++", "", NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "post_decrease") ) {
+                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, node, "", "--", NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "pre_decrease") ) {
+                if ( HCML_ERR_OK != __generate_cxx_wrapper(h, node, "--", "", NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "set") ) {
+                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, node, "=") ) break;
+            } else if ( __cxx_is_tag(_t, node, "great") ) {
+                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, node, ">") ) break;
+            } else if ( __cxx_is_tag(_t, node, "greatequal") ) {
+                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, node, ">=") ) break;
+            } else if ( __cxx_is_tag(_t, node, "less") ) {
+                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, node, "<") ) break;
+            } else if ( __cxx_is_tag(_t, node, "lessequan") ) {
+                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, node, "<=") ) break;
+            } else if ( __cxx_is_tag(_t, node, "equal") ) {
+                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, node, "==") ) break;
+            } else if ( __cxx_is_tag(_t, node, "notequal") ) {
+                if ( HCML_ERR_OK != __generate_cxx_binary_operator(h, node, "!=") ) break;
+            } else if ( __cxx_is_tag(_t, node, "plus") ) {
+                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, node, "+") ) break;
+            } else if ( __cxx_is_tag(_t, node, "minus") ) {
+                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, node, "-") ) break;
+            } else if ( __cxx_is_tag(_t, node, "times") ) {
+                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, node, "*") ) break;
+            } else if ( __cxx_is_tag(_t, node, "divid") ) {
+                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, node, "/") ) break;
+            } else if ( __cxx_is_tag(_t, node, "mod") ) {
+                if ( HCML_ERR_OK != __generate_cxx_self_return_operator(h, node, "%") ) break;
+            } else if ( __cxx_is_tag(_t, node, "return") ) {
                 if ( HCML_ERR_OK != __generate_cxx_keyword(h, "return") ) break;
-            } else if ( __cxx_is_tag(root_tag, "break") ) {
+            } else if ( __cxx_is_tag(_t, node, "break") ) {
                 if ( HCML_ERR_OK != __generate_cxx_keyword(h, "break") ) break;
-            } else if ( __cxx_is_tag(root_tag, "continue") ) {
+            } else if ( __cxx_is_tag(_t, node, "continue") ) {
                 if ( HCML_ERR_OK != __generate_cxx_keyword(h, "continue") ) break;
-            } else if ( __cxx_is_tag(root_tag, "true") ) {
+            } else if ( __cxx_is_tag(_t, node, "true") ) {
                 if ( HCML_ERR_OK != __generate_cxx_keyword(h, "true") ) break;
-            } else if ( __cxx_is_tag(root_tag, "false") ) {
+            } else if ( __cxx_is_tag(_t, node, "false") ) {
                 if ( HCML_ERR_OK != __generate_cxx_keyword(h, "false") ) break;
-            } else if ( __cxx_is_tag(root_tag, "new") ) {
+            } else if ( __cxx_is_tag(_t, node, "new") ) {
                 if ( HCML_ERR_OK != __generate_cxx_keyword(h, "new") ) break;
-            } else if ( __cxx_is_tag(root_tag, "delete") ) {
+            } else if ( __cxx_is_tag(_t, node, "delete") ) {
                 if ( HCML_ERR_OK != __generate_cxx_keyword(h, "delete ") ) break;
-            } else if ( __cxx_is_tag(root_tag, "typeinit") ) {
-                __prop = __cxx_get_prop(root_tag, "type");
+            } else if ( __cxx_is_tag(_t, node, "typeinit") ) {
+                __prop = __cxx_get_prop(_t, node, "type", &_prop);
                 if ( __prop == NULL ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error, missing type name for type init.");
@@ -362,123 +1231,145 @@ int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const c
                 }
 
                 if ( !hcml_append_code_format(h, "%.*s(", __prop->vl, __prop->value) ) break;
-                if ( root_tag->c_tag != NULL ) {
-                    if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, ", ") ) break;
+                if ( _n->child != HCML_NODE_NONE ) {
+                    if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, ", ") ) break;
                     h->rsize -= 2;
                 }
                 if ( !hcml_append_code_format(h, ")" ) ) break;
-            } else if ( __cxx_is_tag(root_tag, "condition") ) {
-                if ( root_tag->c_tag == NULL ) {
+            } else if ( __cxx_is_tag(_t, node, "condition") ) {
+                if ( _n->child == HCML_NODE_NONE ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: invalidate condition, missing case");
                     break;
                 }
-                if ( !__cxx_is_tag(root_tag->c_tag, "case") ) {
+                if ( !__cxx_is_tag(_t, _n->child, "case") ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: invalidate condition, first child must be case");
                     break;
                 }
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "case") ) {
-                if ( root_tag->f_tag == NULL ) {
+                if ( HCML_ERR_OK != hcml_generate_cxx_nodes(h, _n->child, HCML_NODE_NONE, NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "case") ) {
+                if ( _n->parent == HCML_NODE_NONE ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: cannot use case individual");
                     break;
                 }
                 /* First Case */
-                if ( root_tag->f_tag->c_tag == root_tag ) {
+                if ( _t->nodes[_n->parent].child == node ) {
                     if ( !hcml_append_code_format(h, "if ( ") ) break;
                 } else {
                     if ( !hcml_append_code_format(h, "else if ( ") ) break;
                 }
-                if ( __tag_child_count(root_tag) < 2 ) {
+                if ( __tag_child_count(_t, node) < 2 ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: case at least need have two child node");
                     break;
                 }
                 /* Temperate break the relation */
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 0, NULL) )
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 0, NULL) )
                     break;
                 if ( !hcml_append_code_format(h, " ) ") ) break;
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag->n_tag, NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "else") ) {
-                if ( root_tag->f_tag == NULL ) {
+                if ( HCML_ERR_OK != __generate_cxx_probe_body(h, _t->nodes[_n->child].next, "case", NULL) ) break;
+            } else if ( __cxx_is_tag(_t, node, "else") ) {
+                if ( _n->parent == HCML_NODE_NONE ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: cannot use else individual");
                     break;
                 }
                 if ( !hcml_append_code_format(h, "else ") ) break;
-                if ( root_tag->c_tag == NULL ) {
+                if ( _n->child == HCML_NODE_NONE ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: empty else is not allowed");
                     break;
                 }
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->c_tag, "\n") ) break;
-            } else if ( __cxx_is_tag(root_tag, "each") ) {
-                if ( __tag_child_count(root_tag) < 3 ) {
+                if ( HCML_ERR_OK != __generate_cxx_probe_body(h, _n->child, "else", "\n") ) break;
+            } else if ( __cxx_is_tag(_t, node, "each") ) {
+                if ( __tag_child_count(_t, node) < 3 ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: each must have at least 3 child node");
                     break;
                 }
+                /* The probe covers the whole loop */
+                if ( __cxx_has_probe(h) ) {
+                    if ( !hcml_append_code_format(h, "{\n") ) break;
+                    if ( HCML_ERR_OK != __generate_cxx_probe(h, (int)_n->bline, "each") ) break;
+                }
 
+                /* Grow the writer once for the static bytes of all elements */
+                if ( h->reserve_method_l > 0 && h->render_mode == HCML_RENDER_PRINT && 
+                    h->cache_depth == 0 
+                ) {
+                    _pure_string_size = __cxx_static_body_size(h, __child_tag_at_index(_t, node, 2));
+                    if ( h->errcode != HCML_ERR_OK ) break;
+                    if ( _pure_string_size > 0 ) {
+                        if ( !hcml_append_code_format(h, "%s((", h->reserve_method) ) break;
+                        if ( HCML_ERR_OK != __generate_child_at_index(h, node, 1, NULL) ) break;
+                        if ( !hcml_append_code_format(h, ").size() * %d);\n", _pure_string_size) ) break;
+                        _pure_string_size = 0;
+                    }
+                }
                 if ( !hcml_append_code_format(h, "for (") ) break;
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 0, NULL) ) break;
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 0, NULL) ) break;
                 if ( !hcml_append_code_format(h, " : ") ) break;
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 1, NULL) ) break;
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 1, NULL) ) break;
                 if ( !hcml_append_code_format(h, ")") ) break;
 
                 /* All node from 3rd will be formateed as the loop body */
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(
-                    h, __child_tag_at_index(root_tag, 2), NULL) ) break;
-            } else if ( __cxx_is_tag(root_tag, "for") ) {
-                if ( __tag_child_count(root_tag) < 4 ) {
+                if ( HCML_ERR_OK != hcml_generate_cxx_nodes(
+                    h, __child_tag_at_index(_t, node, 2), HCML_NODE_NONE, NULL) ) break;
+                if ( __cxx_has_probe(h) ) {
+                    if ( !hcml_append_code_format(h, "\n}") ) break;
+                }
+            } else if ( __cxx_is_tag(_t, node, "for") ) {
+                if ( __tag_child_count(_t, node) < 4 ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: for must have at least 4 child node");
                     break;
                 }
 
                 if ( !hcml_append_code_format(h, "for (") ) break;
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 0, NULL) ) break;
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 0, NULL) ) break;
                 if ( !hcml_append_code_format(h, "; ") ) break;
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 1, NULL) ) break;
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 1, NULL) ) break;
                 if ( !hcml_append_code_format(h, "; ") ) break;
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 2, NULL) ) break;
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 2, NULL) ) break;
                 if ( !hcml_append_code_format(h, ") ") ) break;
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(
-                    h, __child_tag_at_index(root_tag, 3), NULL) ) 
+                if ( HCML_ERR_OK != hcml_generate_cxx_nodes(
+                    h, __child_tag_at_index(_t, node, 3), HCML_NODE_NONE, NULL) ) 
                     break;
-            } else if ( __cxx_is_tag(root_tag, "while") ) {
-                if ( __tag_child_count(root_tag) < 2 ) {
+            } else if ( __cxx_is_tag(_t, node, "while") ) {
+                if ( __tag_child_count(_t, node) < 2 ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: while must have at least 2 child node");
                     break;
                 }
                 if ( !hcml_append_code_format(h, "while (") ) break;
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 0, NULL) ) break;
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 0, NULL) ) break;
                 if ( !hcml_append_code_format(h, ") ") ) break;
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(
-                    h, __child_tag_at_index(root_tag, 1), NULL) )
+                if ( HCML_ERR_OK != hcml_generate_cxx_nodes(
+                    h, __child_tag_at_index(_t, node, 1), HCML_NODE_NONE, NULL) )
                     break;
-            } else if ( __cxx_is_tag(root_tag, "do") ) {
-                if ( __tag_child_count(root_tag) < 2 ) {
+            } else if ( __cxx_is_tag(_t, node, "do") ) {
+                if ( __tag_child_count(_t, node) < 2 ) {
                     hcml_set_error(h, HCML_ERR_ESYNTAX, 
                         "Syntax Error: while must have at least 2 child node");
                     break;
                 }
                 if ( !hcml_append_code_format(h, "do ") ) break;
-                if ( HCML_ERR_OK != hcml_generate_cxx_lang(
-                    h, __child_tag_at_index(root_tag, 1), NULL) )
+                if ( HCML_ERR_OK != hcml_generate_cxx_nodes(
+                    h, __child_tag_at_index(_t, node, 1), HCML_NODE_NONE, NULL) )
                     break;
                 if ( !hcml_append_code_format(h, " while (") ) break;
-                if ( HCML_ERR_OK != __break_sibling_and_generate(h, root_tag->c_tag, 0, NULL) ) break;
+                if ( HCML_ERR_OK != __generate_child_at_index(h, node, 0, NULL) ) break;
                 if ( !hcml_append_code_format(h, ");") ) break;
             } else {
                 if ( h->exlangfp != NULL ) {
-                    if ( HCML_ERR_OK != (*(hcml_lang_generator)h->exlangfp)(h, root_tag, suf) )
+                    if ( (__view = hcml_get_node_view(h, (int)node)) == NULL ) break;
+                    if ( HCML_ERR_OK != (*(hcml_lang_generator)h->exlangfp)(h, __view, suf) )
                         break;
                 } else {
-                    hcml_set_error(h, HCML_ERR_ESYNTAX, "Syntax Error: Unsupported Tag: %*.s", 
-                        root_tag->dl, root_tag->data_string);
+                    hcml_set_error(h, HCML_ERR_ESYNTAX, "Syntax Error: Unsupported Tag: %.*s", 
+                        (int)_n->data_len, __cxx_data(_t, node));
                     break;
                 }
             }
@@ -486,15 +1377,1048 @@ int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const c
         if ( __peol != NULL ) {
             if ( !hcml_append_code_format(h, ";") ) break;
         }
-        if ( suf != NULL ) {
+        if ( suf != NULL && !_suf_appended ) {
             if ( !hcml_append_code_format(h, "%s", suf) ) 
                 break;
         }
-        if ( root_tag->n_tag != NULL ) {
-            if ( HCML_ERR_OK != hcml_generate_cxx_lang(h, root_tag->n_tag, suf) )
+        /* The glue after the last statement, like a closing brace, is not in the template */
+        if ( h->line_in_template && suf != NULL && suf[0] == '\n' && _last ) {
+            if ( HCML_ERR_OK != __generate_cxx_line_return(h) ) break;
+        }
+        _done = 1;
+    } while ( 0 );
+    return _done;
+}
+
+/* Genearte C++ Code of the sibling list from the node, stops before stop */
+int hcml_generate_cxx_nodes( hcml_node_t *h, uint32_t node, uint32_t stop, const char *suf ) {
+    const struct hcml_node_table_t *_t = __cxx_table(h);
+    for ( ; node != stop && node != HCML_NODE_NONE; node = _t->nodes[node].next ) {
+        if ( !__generate_cxx_node(h, node, stop, suf) ) break;
+    }
+    return h->errcode;
+}
+
+/* Genearte C++ Code according to the parsed tag, the tag is in the node view */
+int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const char*suf ) {
+    int _index = hcml_get_node_index(h, root_tag);
+    if ( _index < 0 ) {
+        hcml_set_error(h, HCML_ERR_ESYNTAX, "Syntax Error, the tag is not in the node view");
+        return h->errcode;
+    }
+    return hcml_generate_cxx_nodes(h, (uint32_t)_index, HCML_NODE_NONE, suf);
+}
+
+/* Check the tag name without prefix match */
+int __cxx_is_exact_tag( const struct hcml_node_table_t *t, uint32_t node, const char *tagname ) {
+    return (t->nodes[node].flags & HCML_CNODE_TAG) && 
+        t->nodes[node].data_len == (uint32_t)strlen(tagname) && 
+        strncmp( __cxx_data(t, node), tagname, t->nodes[node].data_len ) == 0;
+}
+
+/* Unescape the simple string literal in cxx:string, return -1 if cannot be folded */
+int __cxx_fold_unescape( const char *s, int l, char *out ) {
+    int _i, _o;
+    for ( _i = 0, _o = 0; _i < l; ++_i ) {
+        if ( s[_i] == '"' || s[_i] == '\n' || s[_i] == '\r' ) return -1;
+        if ( s[_i] != '\\' ) {
+            out[_o++] = s[_i];
+            continue;
+        }
+        if ( ++_i == l ) return -1;
+        switch ( s[_i] ) {
+            case '"': out[_o++] = '"'; break;
+            case '\'': out[_o++] = '\''; break;
+            case '?': out[_o++] = '?'; break;
+            case '\\': out[_o++] = '\\'; break;
+            case 'n': out[_o++] = '\n'; break;
+            case 'r': out[_o++] = '\r'; break;
+            case 't': out[_o++] = '\t'; break;
+            case 'v': out[_o++] = '\v'; break;
+            case 'f': out[_o++] = '\f'; break;
+            /* Octal, hex and unicode escape are left to the compiler */
+            default: return -1;
+        }
+    }
+    return _o;
+}
+
+/* 
+    Remove the white space after '>' as hcml_append_pure_string does,
+    out can be NULL to get the size only
+ */
+int __cxx_fold_minimize( const char *s, int l, char *out ) {
+    int _i, _o;
+    for ( _i = 0, _o = 0; _i < l; ++_i ) {
+        if ( out != NULL ) out[_o] = s[_i];
+        ++_o;
+#if defined(__MIN_PURE_STRING__) && __MIN_PURE_STRING__ == 1
+        if ( s[_i] == '>' ) {
+            while ( (_i + 1) < l && isspace(s[_i + 1]) ) ++_i;
+        }
+#endif
+    }
+    return _o;
+}
+
+/* Get the value of an integer const tag, return 0 if cannot be folded */
+int __cxx_fold_get_integer( const struct hcml_node_table_t *t, uint32_t node, long long *v ) {
+    const char *_s;
+    int _l, _neg;
+    long long _v;
+    uint32_t _c;
+    if ( !__cxx_is_exact_tag(t, node, "const") || t->nodes[node].prop_count != 0 ) return 0;
+    _c = t->nodes[node].child;
+    if ( _c == HCML_NODE_NONE || (t->nodes[_c].flags & HCML_CNODE_TAG) || 
+        t->nodes[_c].next != HCML_NODE_NONE 
+    ) return 0;
+    _s = __cxx_data(t, _c);
+    _l = (int)t->nodes[_c].data_len;
+    while ( _l > 0 && isspace(_s[_l - 1]) ) --_l;
+    _neg = 0;
+    if ( _l > 0 && _s[0] == '-' ) {
+        _neg = 1; ++_s; --_l;
+    }
+    /* Only decimal literal in int range, no octal, hex or suffix */
+    if ( _l == 0 || _l > 10 || (_l > 1 && _s[0] == '0') ) return 0;
+    for ( _v = 0; _l > 0; ++_s, --_l ) {
+        if ( !isdigit(*_s) ) return 0;
+        _v = _v * 10 + (*_s - '0');
+    }
+    if ( _neg ) _v = -_v;
+    if ( _v < INT_MIN || _v > INT_MAX ) return 0;
+    *v = _v;
+    return 1;
+}
+
+/* Get the arithmetic operator of the tag, 0 if not */
+char __cxx_fold_arithmetic_op( const struct hcml_node_table_t *t, uint32_t node ) {
+    if ( __cxx_is_exact_tag(t, node, "plus") ) return '+';
+    if ( __cxx_is_exact_tag(t, node, "minus") ) return '-';
+    if ( __cxx_is_exact_tag(t, node, "times") ) return '*';
+    if ( __cxx_is_exact_tag(t, node, "divid") ) return '/';
+    if ( __cxx_is_exact_tag(t, node, "mod") ) return '%';
+    return 0;
+}
+
+#define __CXX_FOLD_MAX_OPERAND__        64
+
+/* 
+    Flatten the arithmetic tree to operands as the generated code, the generator 
+    does not add parentheses, so the flat expression is what the compiler sees.
+    ops[i] is the operator before vals[i]. Return 0 if cannot be folded
+ */
+int __cxx_fold_flatten( 
+    const struct hcml_node_table_t *t, uint32_t node, long long *vals, char *ops, int *n 
+) {
+    char _op;
+    uint32_t _c;
+    if ( __cxx_fold_get_integer(t, node, &vals[*n]) ) {
+        ++(*n);
+        return 1;
+    }
+    _op = __cxx_fold_arithmetic_op(t, node);
+    if ( _op == 0 || t->nodes[node].prop_count != 0 || __tag_child_count(t, node) < 2 ) return 0;
+    for ( _c = t->nodes[node].child; _c != HCML_NODE_NONE; _c = t->nodes[_c].next ) {
+        if ( *n == __CXX_FOLD_MAX_OPERAND__ ) return 0;
+        /* The operator before the first operand belongs to the parent */
+        if ( _c != t->nodes[node].child ) ops[*n] = _op;
+        if ( !__cxx_fold_flatten(t, _c, vals, ops, n) ) return 0;
+    }
+    return 1;
+}
+
+/* Apply one operator, return 0 if cannot be folded */
+int __cxx_fold_apply( char op, long long *r, long long v ) {
+    switch ( op ) {
+        case '+': *r += v; break;
+        case '-': *r -= v; break;
+        case '*': *r *= v; break;
+        case '/': if ( v == 0 ) return 0; *r /= v; break;
+        case '%': if ( v == 0 ) return 0; *r %= v; break;
+    }
+    /* Keep the int semantic of the literal expression */
+    return ( *r >= INT_MIN && *r <= INT_MAX );
+}
+
+/* Set the folded data of the node, the data is owned by the table from now on */
+int __cxx_fold_set( 
+    hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node, char *data, int l 
+) {
+    if ( t->fold == NULL ) {
+        t->fold = (char **)__hcml_calloc(t->node_count, sizeof(char *));
+        if ( t->fold == NULL ) {
+            __hcml_free(data);
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Folding Buffer");
+            return HCML_ERR_ERBUFALLOC;
+        }
+    }
+    __hcml_free(t->fold[node]);
+    t->fold[node] = data;
+    t->nodes[node].flags |= HCML_CNODE_FOLDED;
+    t->nodes[node].data_len = (uint32_t)l;
+    return HCML_ERR_OK;
+}
+
+/* Copy the string as the folded data of the node */
+int __cxx_fold_set_copy( 
+    hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node, const char *s, int l 
+) {
+    char *_data = (char *)__hcml_malloc(l + 1);
+    if ( _data == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Folding Buffer");
+        return HCML_ERR_ERBUFALLOC;
+    }
+    memcpy(_data, s, l);
+    _data[l] = '\0';
+    return __cxx_fold_set(h, t, node, _data, l);
+}
+
+/* Fold arithmetic operator of integer const tags to a const tag */
+int __cxx_fold_arithmetic( 
+    hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node, int *folded 
+) {
+    long long _vals[__CXX_FOLD_MAX_OPERAND__], _r, _term;
+    char _ops[__CXX_FOLD_MAX_OPERAND__], _addop, _buf[32];
+    int _n, _i, _l;
+    struct hcml_cnode_t *_c;
+    *folded = 0;
+    _n = 0;
+    if ( !__cxx_fold_flatten(t, node, _vals, _ops, &_n) ) return HCML_ERR_OK;
+    /* Evaluate with C++ precedence, left associative */
+    _r = 0;
+    _addop = '+';
+    _term = _vals[0];
+    for ( _i = 1; _i < _n; ++_i ) {
+        if ( _ops[_i] == '*' || _ops[_i] == '/' || _ops[_i] == '%' ) {
+            if ( !__cxx_fold_apply(_ops[_i], &_term, _vals[_i]) ) return HCML_ERR_OK;
+        } else {
+            if ( !__cxx_fold_apply(_addop, &_r, _term) ) return HCML_ERR_OK;
+            _addop = _ops[_i];
+            _term = _vals[_i];
+        }
+    }
+    if ( !__cxx_fold_apply(_addop, &_r, _term) ) return HCML_ERR_OK;
+
+    /* The first child becomes the literal, the rest are dropped */
+    _l = snprintf(_buf, sizeof(_buf), "%lld", _r);
+    if ( HCML_ERR_OK != __cxx_fold_set_copy(h, t, t->nodes[node].child, _buf, _l) ) 
+        return h->errcode;
+    _c = t->nodes + t->nodes[node].child;
+    _c->flags = HCML_CNODE_ENDED | HCML_CNODE_FOLDED;
+    _c->child = HCML_NODE_NONE;
+    _c->next = HCML_NODE_NONE;
+    _c->prop_count = 0;
+    _c->bline = t->nodes[node].bline;
+    if ( HCML_ERR_OK != __cxx_fold_set_copy(h, t, node, "const", 5) ) return h->errcode;
+    *folded = 1;
+    return HCML_ERR_OK;
+}
+
+/* Make the node a folded static string */
+int __cxx_fold_to_string( 
+    hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node, char *data, int l 
+) {
+    t->nodes[node].flags = (uint8_t)((t->nodes[node].flags & ~HCML_CNODE_TAG) | HCML_CNODE_ENDED);
+    t->nodes[node].child = HCML_NODE_NONE;
+    t->nodes[node].prop_count = 0;
+    return __cxx_fold_set(h, t, node, data, l);
+}
+
+/* Fold cxx:print of cxx:string, or of an integer cxx:const, to a static string node */
+int __cxx_fold_print( hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node ) {
+    uint32_t _s, _c;
+    char *_data, _buf[32];
+    int _l;
+    long long _v;
+    if ( !__cxx_is_exact_tag(t, node, "print") || t->nodes[node].prop_count != 0 ) 
+        return HCML_ERR_OK;
+    _s = t->nodes[node].child;
+    if ( _s == HCML_NODE_NONE || t->nodes[_s].next != HCML_NODE_NONE ) return HCML_ERR_OK;
+    /* The integer is printed as its decimal text */
+    if ( __cxx_fold_get_integer(t, _s, &_v) ) {
+        _l = snprintf(_buf, sizeof(_buf), "%lld", _v);
+        _data = (char *)__hcml_malloc(_l + 1);
+        if ( _data == NULL ) {
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Folding Buffer");
+            return HCML_ERR_ERBUFALLOC;
+        }
+        memcpy(_data, _buf, _l + 1);
+        return __cxx_fold_to_string(h, t, node, _data, _l);
+    }
+    if ( !__cxx_is_exact_tag(t, _s, "string") || t->nodes[_s].prop_count != 0 ) 
+        return HCML_ERR_OK;
+    _c = t->nodes[_s].child;
+    if ( _c != HCML_NODE_NONE && 
+        ((t->nodes[_c].flags & HCML_CNODE_TAG) || t->nodes[_c].next != HCML_NODE_NONE) 
+    ) return HCML_ERR_OK;
+    _l = (_c == HCML_NODE_NONE ? 0 : (int)t->nodes[_c].data_len);
+    _data = (char *)__hcml_malloc(_l + 1);
+    if ( _data == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Folding Buffer");
+        return HCML_ERR_ERBUFALLOC;
+    }
+    if ( _l > 0 ) {
+        _l = __cxx_fold_unescape(__cxx_data(t, _c), _l, _data);
+        if ( _l < 0 ) {
+            __hcml_free(_data);
+            return HCML_ERR_OK;
+        }
+    }
+    return __cxx_fold_to_string(h, t, node, _data, _l);
+}
+
+/* Copy the minimized data of the string node to a new buffer with extra room */
+int __cxx_fold_own_string( 
+    hcml_node_t *h, const struct hcml_node_table_t *t, uint32_t node, int extra, char **data 
+) {
+    int _l;
+    *data = (char *)__hcml_malloc(t->nodes[node].data_len + extra + 1);
+    if ( *data == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Folding Buffer");
+        return -1;
+    }
+    if ( t->nodes[node].flags & HCML_CNODE_FOLDED ) {
+        memcpy(*data, t->fold[node], t->nodes[node].data_len);
+        _l = (int)t->nodes[node].data_len;
+    } else {
+        _l = __cxx_fold_minimize(__cxx_data(t, node), (int)t->nodes[node].data_len, *data);
+    }
+    return _l;
+}
+
+/* Merge adjacent static strings in a statement list, drop the empty ones */
+int __cxx_fold_merge( hcml_node_t *h, struct hcml_node_table_t *t, uint32_t *head ) {
+    uint32_t *_pt, _i, _n;
+    char *_data;
+    int _l;
+    _pt = head;
+    while ( *_pt != HCML_NODE_NONE ) {
+        _i = *_pt;
+        if ( !(t->nodes[_i].flags & HCML_CNODE_TAG) && 
+            (t->nodes[_i].flags & HCML_CNODE_FOLDED) && t->nodes[_i].data_len == 0 
+        ) {
+            *_pt = t->nodes[_i].next;
+            continue;
+        }
+        _n = t->nodes[_i].next;
+        if ( !(t->nodes[_i].flags & HCML_CNODE_TAG) && _n != HCML_NODE_NONE && 
+            !(t->nodes[_n].flags & HCML_CNODE_TAG) 
+        ) {
+            _l = __cxx_fold_own_string(h, t, _i, (int)t->nodes[_n].data_len, &_data);
+            if ( _l < 0 ) return h->errcode;
+            if ( t->nodes[_n].flags & HCML_CNODE_FOLDED ) {
+                memcpy(_data + _l, t->fold[_n], t->nodes[_n].data_len);
+                _l += (int)t->nodes[_n].data_len;
+            } else {
+                _l += __cxx_fold_minimize(__cxx_data(t, _n), (int)t->nodes[_n].data_len, _data + _l);
+            }
+            if ( HCML_ERR_OK != __cxx_fold_set(h, t, _i, _data, _l) ) return h->errcode;
+            t->nodes[_i].next = t->nodes[_n].next;
+            /* Go on merging with the new next one */
+            continue;
+        }
+        _pt = &t->nodes[_i].next;
+    }
+    return HCML_ERR_OK;
+}
+
+#define __CXX_FOLD_EXPRESSION__         0
+#define __CXX_FOLD_STATEMENT__          1
+#define __CXX_FOLD_OPERAND__            2
+
+/* Fold all nodes in the sibling list */
+int __cxx_fold_list( hcml_node_t *h, struct hcml_node_table_t *t, uint32_t *head, int ctx );
+
+/* Fold the included template, and make the tag a static string if it is static */
+int __cxx_fold_include( hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node ) {
+    struct hcml_prop_t _src;
+    struct hcml_include_t *_inc, *_saved_inc;
+    char *_data;
+    int _l;
+    /* Let the generator report the syntax error */
+    if ( __cxx_get_prop(t, node, "src", &_src) == NULL ) return HCML_ERR_OK;
+    _inc = hcml_load_include(h, _src.value, _src.vl, (int)t->nodes[node].bline);
+    if ( _inc == NULL ) return h->errcode;
+    if ( !_inc->folded ) {
+        _saved_inc = h->cur_inc;
+        h->cur_inc = _inc;
+        _inc->busy = 1;
+        __free_node_view(_inc->table);
+        __cxx_fold_list(h, _inc->table, &_inc->root, __CXX_FOLD_STATEMENT__);
+        _inc->busy = 0;
+        h->cur_inc = _saved_inc;
+        if ( h->errcode != HCML_ERR_OK ) return h->errcode;
+        _inc->folded = 1;
+    }
+    if ( _inc->root != HCML_NODE_NONE && 
+        ((_inc->table->nodes[_inc->root].flags & HCML_CNODE_TAG) || 
+        _inc->table->nodes[_inc->root].next != HCML_NODE_NONE) 
+    ) return HCML_ERR_OK;
+    /* Static template, splice the string */
+    _l = 0;
+    if ( _inc->root != HCML_NODE_NONE ) {
+        _l = __cxx_fold_own_string(h, _inc->table, _inc->root, 0, &_data);
+        if ( _l < 0 ) return h->errcode;
+    } else {
+        _data = (char *)__hcml_malloc(1);
+        if ( _data == NULL ) {
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Folding Buffer");
+            return HCML_ERR_ERBUFALLOC;
+        }
+    }
+    return __cxx_fold_to_string(h, t, node, _data, _l);
+}
+
+/* Fold all nodes in the sibling list */
+int __cxx_fold_list( hcml_node_t *h, struct hcml_node_table_t *t, uint32_t *head, int ctx ) {
+    uint32_t _i;
+    int _folded, _cctx;
+    for ( _i = *head; _i != HCML_NODE_NONE; _i = t->nodes[_i].next ) {
+        if ( !(t->nodes[_i].flags & HCML_CNODE_TAG) ) continue;
+        /* Leave the registered tag and its children to its generator */
+        if ( __find_node_tag(h, t, _i) != NULL ) continue;
+        _folded = 0;
+        /* Only the outermost operator can be folded, a sub expression is not 
+            standalone without parentheses */
+        if ( ctx != __CXX_FOLD_OPERAND__ ) {
+            if ( HCML_ERR_OK != __cxx_fold_arithmetic(h, t, _i, &_folded) ) return h->errcode;
+        }
+        if ( !_folded && t->nodes[_i].child != HCML_NODE_NONE ) {
+            if ( __cxx_fold_arithmetic_op(t, _i) != 0 ) _cctx = __CXX_FOLD_OPERAND__;
+            else if ( __cxx_is_exact_tag(t, _i, "block") || __cxx_is_exact_tag(t, _i, "cache") ) 
+                _cctx = __CXX_FOLD_STATEMENT__;
+            else _cctx = __CXX_FOLD_EXPRESSION__;
+            if ( HCML_ERR_OK != __cxx_fold_list(h, t, &t->nodes[_i].child, _cctx) ) 
+                return h->errcode;
+        }
+        /* Only statement can be folded to static string */
+        if ( ctx == __CXX_FOLD_STATEMENT__ ) {
+            if ( __cxx_is_exact_tag(t, _i, "include") ) {
+                if ( HCML_ERR_OK != __cxx_fold_include(h, t, _i) ) return h->errcode;
+                continue;
+            }
+            if ( HCML_ERR_OK != __cxx_fold_print(h, t, _i) ) return h->errcode;
+        }
+    }
+    if ( ctx == __CXX_FOLD_STATEMENT__ ) return __cxx_fold_merge(h, t, head);
+    return HCML_ERR_OK;
+}
+
+/* 
+    Fold constant subtrees to static string or literal before generating,
+    root may be changed or set to HCML_NODE_NONE when nothing left 
+ */
+int hcml_fold_cxx_lang( hcml_node_t *h, uint32_t *root ) {
+    struct hcml_node_table_t *_t = h->table;
+    uint32_t _r;
+    char *_data;
+    int _l;
+    /* The nodes are changed, the view is built again when needed */
+    __free_node_view(_t);
+    if ( HCML_ERR_OK != __cxx_fold_list(h, _t, root, __CXX_FOLD_STATEMENT__) ) return h->errcode;
+    _r = *root;
+    if ( _r == HCML_NODE_NONE ) {
+        h->is_static = 1;
+        h->static_size = 0;
+        snprintf(h->static_etag, sizeof(h->static_etag), "\"%016llx\"", __hash_fnv1a("", 0));
+        return HCML_ERR_OK;
+    }
+    if ( (_t->nodes[_r].flags & HCML_CNODE_TAG) || _t->nodes[_r].next != HCML_NODE_NONE ) 
+        return HCML_ERR_OK;
+    /* The whole template is a static string */
+    if ( !(_t->nodes[_r].flags & HCML_CNODE_FOLDED) ) {
+        _l = __cxx_fold_own_string(h, _t, _r, 0, &_data);
+        if ( _l < 0 ) return h->errcode;
+        if ( HCML_ERR_OK != __cxx_fold_set(h, _t, _r, _data, _l) ) return h->errcode;
+    }
+    h->is_static = 1;
+    h->static_size = (int)_t->nodes[_r].data_len;
+    snprintf(h->static_etag, sizeof(h->static_etag), "\"%016llx\"", 
+        __hash_fnv1a(__cxx_data(_t, _r), (int)_t->nodes[_r].data_len));
+    return HCML_ERR_OK;
+}
+
+/* 
+    Check the tree can be generated in parallel, without cxx:cache which
+    numbers the sites in order, and load all included templates
+ */
+int __cxx_parallel_scan( hcml_node_t *h, uint32_t node, int depth ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    struct hcml_prop_t _src;
+    struct hcml_include_t *_inc, *_saved_inc;
+    int _ok;
+    for ( ; node != HCML_NODE_NONE; node = _t->nodes[node].next ) {
+        if ( !(_t->nodes[node].flags & HCML_CNODE_TAG) ) continue;
+        if ( __cxx_is_exact_tag(_t, node, "cache") ) return 0;
+        /* A schema binds the names for the statements after it */
+        if ( __cxx_is_exact_tag(_t, node, "schema") ) return 0;
+        if ( __cxx_is_exact_tag(_t, node, "var") && __cxx_has_prop(_t, node, "schema") ) return 0;
+        if ( __cxx_is_exact_tag(_t, node, "include") ) {
+            if ( __cxx_get_prop(_t, node, "src", &_src) == NULL || depth >= 16 ) return 0;
+            _inc = hcml_load_include(h, _src.value, _src.vl, (int)_t->nodes[node].bline);
+            if ( _inc == NULL ) return 0;
+            _saved_inc = h->cur_inc;
+            h->cur_inc = _inc;
+            _inc->busy = 1;
+            _ok = __cxx_parallel_scan(h, _inc->root, depth + 1);
+            _inc->busy = 0;
+            h->cur_inc = _saved_inc;
+            if ( !_ok ) return 0;
+            continue;
+        }
+        if ( !__cxx_parallel_scan(h, _t->nodes[node].child, depth) ) return 0;
+    }
+    return 1;
+}
+
+/* 
+    Check the top-level statements can be generated in parallel, no state
+    is carried from one to the next. All included templates are loaded, 
+    any error is left to the serial generation to report
+ */
+int hcml_prepare_cxx_parallel( hcml_node_t *h, uint32_t root ) {
+    if ( h->langfp != (void *)&hcml_generate_cxx_lang || h->exlangfp != NULL || 
+        h->tag_count > 0 || h->render_mode == HCML_RENDER_RAWBUF || 
+        h->flush_threshold > 0 || h->probes != HCML_PROBE_NONE || 
+        h->outline_size > 0 || h->is_static 
+    ) {
+        return 0;
+    }
+    if ( __cxx_parallel_scan(h, root, 0) ) return 1;
+    h->errcode = HCML_ERR_OK;
+    h->errmsg[0] = '\0';
+    h->cur_inc = NULL;
+    return 0;
+}
+
+/* Flags of a top-level statement scanned before outlining */
+#define __CXX_OUTLINE_DECLARE       1
+#define __CXX_OUTLINE_RETURN        2
+
+/* Tags with their own C++ scope, names declared inside are not visible after */
+int __cxx_is_scope_tag( const struct hcml_node_table_t *t, uint32_t node ) {
+    return __cxx_is_exact_tag(t, node, "block") || __cxx_is_exact_tag(t, node, "each") || 
+        __cxx_is_exact_tag(t, node, "for") || __cxx_is_exact_tag(t, node, "while") || 
+        __cxx_is_exact_tag(t, node, "do") || __cxx_is_exact_tag(t, node, "condition") || 
+        __cxx_is_exact_tag(t, node, "case") || __cxx_is_exact_tag(t, node, "else") || 
+        __cxx_is_exact_tag(t, node, "cache");
+}
+
+/* 
+    Scan the statement, if it declares a name in the scope it is generated,
+    or returns from the function, the included templates are scanned too
+ */
+int __cxx_outline_scan( hcml_node_t *h, uint32_t node, int top, int depth ) {
+    struct hcml_node_table_t *_t = __cxx_table(h);
+    struct hcml_prop_t _src;
+    struct hcml_include_t *_inc, *_saved_inc;
+    uint32_t _c;
+    int _flags = 0;
+    if ( !(_t->nodes[node].flags & HCML_CNODE_TAG) ) return 0;
+    if ( __find_node_tag(h, _t, node) != NULL ) return ( top ? __CXX_OUTLINE_DECLARE : 0 );
+    if ( __cxx_is_exact_tag(_t, node, "return") ) return __CXX_OUTLINE_RETURN;
+    if ( top && __cxx_is_exact_tag(_t, node, "code") ) return __CXX_OUTLINE_DECLARE;
+    if ( top && __cxx_is_exact_tag(_t, node, "var") && __cxx_has_prop(_t, node, "type") ) {
+        return __CXX_OUTLINE_DECLARE;
+    }
+    if ( __cxx_is_exact_tag(_t, node, "include") ) {
+        /* Too deep, maybe recursive, the generator reports it */
+        if ( depth >= 16 ) return __CXX_OUTLINE_DECLARE;
+        if ( __cxx_get_prop(_t, node, "src", &_src) == NULL ) return 0;
+        _inc = hcml_load_include(h, _src.value, _src.vl, (int)_t->nodes[node].bline);
+        if ( _inc == NULL ) return __CXX_OUTLINE_DECLARE;
+        /* Nested includes are relative to the included template */
+        _saved_inc = h->cur_inc;
+        h->cur_inc = _inc;
+        for ( _c = _inc->root; _c != HCML_NODE_NONE; _c = _inc->table->nodes[_c].next ) {
+            _flags |= __cxx_outline_scan(h, _c, top, depth + 1);
+        }
+        h->cur_inc = _saved_inc;
+        return _flags;
+    }
+    if ( __cxx_is_scope_tag(_t, node) ) top = 0;
+    for ( _c = _t->nodes[node].child; _c != HCML_NODE_NONE; _c = _t->nodes[_c].next ) {
+        _flags |= __cxx_outline_scan(h, _c, top, depth);
+    }
+    return _flags;
+}
+
+/* Append the code to the shard */
+int __append_outline_data( hcml_node_t *h, struct hcml_outline_t *o, const char *s, int l ) {
+    char *_code;
+    int _size;
+    if ( o->bufsize - o->size <= l ) {
+        for ( _size = (o->bufsize == 0 ? 1024 : o->bufsize); _size - o->size <= l; _size *= 2 );
+        _code = (char *)__hcml_realloc(o->code, _size);
+        if ( _code == NULL ) {
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Outline Buffer");
+            return 0;
+        }
+        o->code = _code;
+        o->bufsize = _size;
+    }
+    memcpy(o->code + o->size, s, l);
+    o->size += l;
+    o->code[o->size] = '\0';
+    return 1;
+}
+
+/* The raw buffer is passed to the outlined functions by reference */
+const char * __cxx_outline_rawbuf( hcml_node_t *h, const char *list, int params ) {
+    if ( h->render_mode != HCML_RENDER_RAWBUF ) return "";
+    if ( params ) {
+        return ( list[0] != '\0' ? ", char *&hcml_cur, char *&hcml_end" : "char *&hcml_cur, char *&hcml_end" );
+    }
+    return ( list[0] != '\0' ? ", hcml_cur, hcml_end" : "hcml_cur, hcml_end" );
+}
+
+/* 
+    Move the code generated since begin to a new function in the smallest
+    shard, and call it in place
+ */
+int __generate_cxx_outline_part( hcml_node_t *h, int begin ) {
+    struct hcml_outline_t *_o;
+    char _name[64];
+    int _i, _code_l, _head_l, _shards;
+    snprintf(_name, sizeof(_name), "hcml_part_%016llx_%d", 
+        __hash_fnv1a(h->src_name, (int)strlen(h->src_name)), h->outline_count);
+    _shards = (h->outline_shards > 0 ? h->outline_shards : 1);
+    _o = h->outlines;
+    for ( _i = 1; _i < _shards; ++_i ) {
+        if ( h->outlines[_i].size < _o->size ) _o = h->outlines + _i;
+    }
+    /* The head is formatted after the code, then both are moved */
+    _code_l = h->rsize - begin;
+    if ( !hcml_append_code_format(h, "%svoid %s(%s%s) {\n", 
+        (h->outline_shards > 0 ? "" : "static "), _name, h->outline_params, 
+        __cxx_outline_rawbuf(h, h->outline_params, 1)) 
+    ) return h->errcode;
+    _head_l = h->rsize - begin - _code_l;
+    if ( !__append_outline_data(h, _o, h->presult + begin + _code_l, _head_l) ) return h->errcode;
+    if ( !__append_outline_data(h, _o, h->presult + begin, _code_l) ) return h->errcode;
+    if ( !__append_outline_data(h, _o, "}\n", 2) ) return h->errcode;
+    h->rsize = begin;
+    h->presult[h->rsize] = '\0';
+    ++h->outline_count;
+
+    /* A function with external linkage is declared in the block scope */
+    if ( h->outline_shards > 0 ) {
+        if ( !hcml_append_code_format(h, "void %s(%s%s);\n", _name, h->outline_params, 
+            __cxx_outline_rawbuf(h, h->outline_params, 1))
+        ) return h->errcode;
+    }
+    hcml_append_code_format(h, "%s(%s%s);\n", _name, h->outline_args, 
+        __cxx_outline_rawbuf(h, h->outline_args, 0));
+    return h->errcode;
+}
+
+/* 
+    Generate C++ Code, runs of top-level statements reaching the outline size
+    are moved to the outlined functions
+ */
+int hcml_generate_cxx_outline( hcml_node_t *h, uint32_t root, const char*suf ) {
+    const struct hcml_node_table_t *_t = h->table;
+    uint32_t _node;
+    int _begin, _flags;
+    /* A coroutine body can not be split */
+    if ( h->render_mode == HCML_RENDER_COROUTINE || h->outline_alloc == 0 || 
+        h->outline_params == NULL || h->outline_args == NULL 
+    ) {
+        return hcml_generate_cxx_nodes(h, root, HCML_NODE_NONE, suf);
+    }
+    _begin = h->rsize;
+    for ( _node = root; _node != HCML_NODE_NONE; _node = _t->nodes[_node].next ) {
+        _flags = __cxx_outline_scan(h, _node, 1, 0);
+        if ( h->errcode != HCML_ERR_OK ) break;
+        /* Names declared here may be used by all statements after */
+        if ( _flags & __CXX_OUTLINE_DECLARE ) {
+            hcml_generate_cxx_nodes(h, _node, HCML_NODE_NONE, suf);
+            break;
+        }
+        hcml_generate_cxx_nodes(h, _node, _t->nodes[_node].next, suf);
+        if ( h->errcode != HCML_ERR_OK ) break;
+        if ( _flags & __CXX_OUTLINE_RETURN ) {
+            /* Kept in place, with the statements before it */
+            _begin = h->rsize;
+        } else if ( h->rsize - _begin >= h->outline_size ) {
+            if ( HCML_ERR_OK != __generate_cxx_outline_part(h, _begin) ) break;
+            _begin = h->rsize;
+        }
+    }
+    return h->errcode;
+}
+
+/* 
+    Render function name of the template: hcml_render_ and the name with 
+    '_' doubled and other non-alnum chars as _xx hex, return the length 
+    or -1 when the buffer is too small
+ */
+int hcml_cxx_render_name( const char *name, char *buf, int size ) {
+    static const char *_hex = "0123456789abcdef";
+    int _l = 0;
+    if ( size < 13 ) return -1;
+    memcpy(buf, "hcml_render_", 12);
+    _l = 12;
+    for ( ; *name != '\0'; ++name ) {
+        if ( _l + 4 > size ) return -1;
+        if ( isalnum((unsigned char)*name) ) {
+            buf[_l++] = *name;
+        } else if ( *name == '_' ) {
+            buf[_l++] = '_';
+            buf[_l++] = '_';
+        } else {
+            buf[_l++] = '_';
+            buf[_l++] = _hex[((unsigned char)*name) >> 4];
+            buf[_l++] = _hex[((unsigned char)*name) & 0x0F];
+        }
+    }
+    buf[_l] = '\0';
+    return _l;
+}
+
+/* Seeded FNV-1a of the registry, the generated lookup is the same */
+unsigned long long __cxx_registry_hash( long long seed, const char *s, int l ) {
+    unsigned long long _h = 14695981039346656037ULL ^ 
+        ((unsigned long long)seed * 0x9E3779B97F4A7C15ULL);
+    int _i;
+    for ( _i = 0; _i < l; ++_i ) {
+        _h ^= (unsigned char)s[_i];
+        _h *= 1099511628211ULL;
+    }
+    return _h;
+}
+
+/* Bucket of the registry, sorted by size */
+struct __cxx_registry_bucket_t {
+    int     index;
+    int     size;
+};
+
+int __cxx_registry_bucket_cmp( const void *a, const void *b ) {
+    const struct __cxx_registry_bucket_t *_a = (const struct __cxx_registry_bucket_t *)a;
+    const struct __cxx_registry_bucket_t *_b = (const struct __cxx_registry_bucket_t *)b;
+    if ( _a->size != _b->size ) return _b->size - _a->size;
+    return _a->index - _b->index;
+}
+
+/* 
+    Hash and displace: the names are hashed to buckets, every bucket with 
+    more names finds the seed to hash them to free slots, a single name 
+    takes a free slot directly, stored as -slot-1
+ */
+int __cxx_registry_perfect_hash( hcml_node_t *h, const char * const *names, int count, 
+    long long *seeds, int *slots 
+) {
+    struct __cxx_registry_bucket_t *_buckets;
+    int *_first, *_next, *_pos, *_used;
+    int _i, _b, _k, _n, _free, _ok;
+    long long _seed;
+
+    _buckets = (struct __cxx_registry_bucket_t *)__hcml_calloc(count, 
+        sizeof(struct __cxx_registry_bucket_t));
+    _first = (int *)__hcml_malloc(count * sizeof(int));
+    _next = (int *)__hcml_malloc(count * sizeof(int));
+    _pos = (int *)__hcml_malloc(count * sizeof(int));
+    _used = (int *)__hcml_calloc(count, sizeof(int));
+    if ( _buckets == NULL || _first == NULL || _next == NULL || _pos == NULL || _used == NULL ) {
+        hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Registry");
+        __hcml_free(_buckets); __hcml_free(_first); __hcml_free(_next); 
+        __hcml_free(_pos); __hcml_free(_used);
+        return h->errcode;
+    }
+    for ( _i = 0; _i < count; ++_i ) {
+        _first[_i] = -1;
+        _buckets[_i].index = _i;
+        seeds[_i] = 0;
+        slots[_i] = -1;
+    }
+    for ( _i = count - 1; _i >= 0; --_i ) {
+        _b = (int)(__cxx_registry_hash(0, names[_i], (int)strlen(names[_i])) % (unsigned)count);
+        _next[_i] = _first[_b];
+        _first[_b] = _i;
+        ++_buckets[_b].size;
+    }
+    qsort(_buckets, count, sizeof(struct __cxx_registry_bucket_t), __cxx_registry_bucket_cmp);
+
+    _free = 0;
+    for ( _b = 0; _b < count && _buckets[_b].size > 0; ++_b ) {
+        _i = _buckets[_b].index;
+        if ( _buckets[_b].size == 1 ) {
+            while ( _used[_free] ) ++_free;
+            _used[_free] = 1;
+            slots[_free] = _first[_i];
+            seeds[_i] = -(long long)_free - 1;
+            continue;
+        }
+        for ( _seed = 1; _seed < (1LL << 24); ++_seed ) {
+            _ok = 1;
+            _n = 0;
+            for ( _k = _first[_i]; _k >= 0; _k = _next[_k] ) {
+                _pos[_n] = (int)(__cxx_registry_hash(_seed, names[_k], 
+                    (int)strlen(names[_k])) % (unsigned)count);
+                if ( _used[_pos[_n]] ) {
+                    _ok = 0;
+                    break;
+                }
+                /* Mark now to find the collision in the bucket */
+                _used[_pos[_n++]] = 1;
+            }
+            if ( _ok ) break;
+            /* Undo the marks of this seed */
+            for ( _k = 0; _k < _n; ++_k ) _used[_pos[_k]] = 0;
+        }
+        if ( _seed == (1LL << 24) ) {
+            hcml_set_error(h, HCML_ERR_ESYNTAX, "Registry Error: cannot find the perfect hash");
+            break;
+        }
+        seeds[_i] = _seed;
+        _n = 0;
+        for ( _k = _first[_i]; _k >= 0; _k = _next[_k] ) slots[_pos[_n++]] = _k;
+    }
+    __hcml_free(_buckets); __hcml_free(_first); __hcml_free(_next); 
+    __hcml_free(_pos); __hcml_free(_used);
+    return h->errcode;
+}
+/* Check the names are unique */
+int __cxx_registry_unique( hcml_node_t *h, const char * const *names, int count ) {
+    int _i, _j;
+    for ( _i = 0; _i < count; ++_i ) {
+        for ( _j = 0; _j < _i; ++_j ) {
+            if ( strcmp(names[_i], names[_j]) != 0 ) continue;
+            hcml_set_error(h, HCML_ERR_ESYNTAX, "Registry Error: duplicate name %s", names[_i]);
+            return h->errcode;
+        }
+    }
+    return HCML_ERR_OK;
+}
+
+/* Generate the seeds and the lookup function, the entries are generated by slots */
+int __generate_cxx_registry_lookup( hcml_node_t *h, const char *prefix, 
+    const long long *seeds, int count, const char *ret_type, const char *fn, const char *ret 
+) {
+    int _i;
+    if ( !hcml_append_code_format(h, 
+        "/* Seed of each bucket, -slot-1 for a bucket with single name */\n"
+        "const long long %s_seeds[%d] = {", prefix, count) ) return h->errcode;
+    for ( _i = 0; _i < count; ++_i ) {
+        if ( !hcml_append_code_format(h, "%s%lld,", 
+            ((_i % 8) == 0 ? "\n    " : " "), seeds[_i]) ) return h->errcode;
+    }
+    hcml_append_code_format(h, "\n};\n\n"
+        "}\n\n"
+        "%s %s( const char *name, size_t length ) {\n"
+        "    long long _seed = %s_seeds[hcml_registry_hash(0, name, length) %% %dULL];\n"
+        "    size_t _slot = ( _seed < 0 ? (size_t)(-_seed - 1) : \n"
+        "        (size_t)(hcml_registry_hash(_seed, name, length) %% %dULL) );\n"
+        "    const %s_entry_t &_e = %s_entries[_slot];\n"
+        "    if ( _e.length != length || std::memcmp(_e.name, name, length) != 0 ) return 0;\n"
+        "    return %s;\n"
+        "}\n\n", ret_type, fn, prefix, count, count, prefix, prefix, ret);
+    return h->errcode;
+}
+
+/* Generate the name of an entry */
+int __generate_cxx_registry_name( hcml_node_t *h, const char *name ) {
+    if ( !hcml_append_code_format(h, "    { \"") ) return h->errcode;
+    hcml_append_escaped_string(h, name, (int)strlen(name));
+    hcml_append_code_format(h, "\", %d, ", (int)strlen(name));
+    return h->errcode;
+}
+
+/* MIME type by the file extension */
+const char * __cxx_asset_mime( const char *path ) {
+    static const char *_types[] = {
+        "html", "text/html", "htm", "text/html", "css", "text/css", 
+        "js", "text/javascript", "mjs", "text/javascript", "json", "application/json", 
+        "map", "application/json", "xml", "application/xml", "txt", "text/plain", 
+        "svg", "image/svg+xml", "png", "image/png", "jpg", "image/jpeg", 
+        "jpeg", "image/jpeg", "gif", "image/gif", "webp", "image/webp", 
+        "ico", "image/x-icon", "woff", "font/woff", "woff2", "font/woff2", 
+        "ttf", "font/ttf", "wasm", "application/wasm", "pdf", "application/pdf", 
+        NULL
+    };
+    const char *_ext = strrchr(path, '.');
+    int _i, _j;
+    if ( _ext != NULL && strchr(_ext, '/') == NULL ) {
+        ++_ext;
+        for ( _i = 0; _types[_i] != NULL; _i += 2 ) {
+            for ( _j = 0; _ext[_j] != '\0' && tolower((unsigned char)_ext[_j]) == _types[_i][_j]; ++_j );
+            if ( _ext[_j] == '\0' && _types[_i][_j] == '\0' ) return _types[_i + 1];
+        }
+    }
+    return "application/octet-stream";
+}
+
+/* Embed the asset file as a static content */
+int __generate_cxx_asset( hcml_node_t *h, int index, const char *path ) {
+    char _name[64], _gzip[64], _deflate[64];
+    char *_data;
+    int _size, _gzip_size, _deflate_size;
+    _size = __read_source_file(h, path, &_data);
+    if ( _size < 0 ) {
+        hcml_set_error(h, h->errcode, "Asset Error: cannot read %s", path);
+        return h->errcode;
+    }
+    snprintf(_name, sizeof(_name), "hcml_asset_%d_data", index);
+    snprintf(_gzip, sizeof(_gzip), "hcml_asset_%d_gzip", index);
+    snprintf(_deflate, sizeof(_deflate), "hcml_asset_%d_deflate", index);
+    do {
+        if ( !hcml_append_code_format(h, "const char %s[] =\n", _name) ) break;
+        if ( __generate_cxx_string_literal(h, (const unsigned char *)_data, _size) < 0 ) break;
+        if ( !hcml_append_code_format(h, ";\n") ) break;
+        /* Compressed only when smaller */
+        _gzip_size = __generate_cxx_compressed(h, _gzip, _data, _size, 15 + 16, _size);
+        if ( _gzip_size < 0 ) break;
+        _deflate_size = __generate_cxx_compressed(h, _deflate, _data, _size, 15, _size);
+        if ( _deflate_size < 0 ) break;
+        hcml_append_code_format(h, 
+            "const hcml::rt::static_content hcml_asset_%d = {\n"
+            "    %s, %d,\n    %s, %d,\n    %s, %d,\n"
+            "    \"\\\"%016llx\\\"\", \"%s\"\n};\n\n",
+            index, _name, _size, 
+            (_gzip_size > 0 ? _gzip : "nullptr"), _gzip_size,
+            (_deflate_size > 0 ? _deflate : "nullptr"), _deflate_size,
+            __hash_fnv1a(_data, _size), __cxx_asset_mime(path));
+    } while ( 0 );
+    __hcml_free(_data);
+    return h->errcode;
+}
+
+/*
+    Generate the registry of the templates and the assets to the output, 
+    a name is found through a perfect hash computed at generation time.
+    params is the parameter list of the render functions
+ */
+int hcml_generate_cxx_registry( hcml_node_t *h, const char * const *names, int count, 
+    const char * const *assets, int asset_count, const char *params, 
+    const char * const *headers, int header_count 
+) {
+    char _fn[PATH_MAX + 64];
+    long long *_seeds, *_asset_seeds;
+    int *_slots, *_asset_slots;
+    int _i;
+
+    h->errcode = HCML_ERR_OK;
+    h->errmsg[0] = '\0';
+    if ( h->presult == NULL ) {
+        h->bufsize = 1024;
+        h->presult = (char *)__hcml_malloc(h->bufsize);
+        if ( h->presult == NULL ) {
+            h->bufsize = 0;
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Result Buffer");
+            return h->errcode;
+        }
+    }
+    h->rsize = 0;
+    h->presult[0] = '\0';
+    if ( params == NULL ) params = "std::ostream &resp";
+    if ( HCML_ERR_OK != __cxx_registry_unique(h, names, count) ) return h->errcode;
+    if ( HCML_ERR_OK != __cxx_registry_unique(h, assets, asset_count) ) return h->errcode;
+
+    _seeds = (long long *)__hcml_malloc((count + 1) * sizeof(long long));
+    _slots = (int *)__hcml_malloc((count + 1) * sizeof(int));
+    _asset_seeds = (long long *)__hcml_malloc((asset_count + 1) * sizeof(long long));
+    _asset_slots = (int *)__hcml_malloc((asset_count + 1) * sizeof(int));
+    do {
+        if ( _seeds == NULL || _slots == NULL || _asset_seeds == NULL || _asset_slots == NULL ) {
+            hcml_set_error(h, HCML_ERR_ERBUFALLOC, "Malloc Error for Registry");
+            break;
+        }
+        if ( count > 0 && HCML_ERR_OK != __cxx_registry_perfect_hash(h, names, count, _seeds, _slots) ) {
+            break;
+        }
+        if ( asset_count > 0 && HCML_ERR_OK != __cxx_registry_perfect_hash(
+            h, assets, asset_count, _asset_seeds, _asset_slots) 
+        ) {
+            break;
+        }
+        if ( !hcml_append_code_format(h, 
+            "// Registry generated by hcml, %d template(s), %d asset(s)\n"
+            "#include <cstddef>\n#include <cstring>\n#include <ostream>\n%s", 
+            count, asset_count, (asset_count > 0 ? "#include <hcml_runtime.hpp>\n" : "")) ) break;
+        /* The user types in params are declared by the same headers as the unity files */
+        for ( _i = 0; _i < header_count; ++_i ) {
+            if ( !hcml_append_code_format(h, "#include \"%s\"\n", headers[_i]) ) break;
+        }
+        if ( _i < header_count || !hcml_append_code_format(h, "\n") ) break;
+        for ( _i = 0; _i < count; ++_i ) {
+            if ( hcml_cxx_render_name(names[_i], _fn, sizeof(_fn)) < 0 ) {
+                hcml_set_error(h, HCML_ERR_ESYNTAX, "Registry Error: name too long %s", names[_i]);
                 break;
+            }
+            if ( !hcml_append_code_format(h, "void %s( %s );\n", _fn, params) ) break;
+        }
+        if ( h->errcode != HCML_ERR_OK ) break;
+        if ( !hcml_append_code_format(h, 
+            "\ntypedef void (*hcml_render_fn)( %s );\n\n"
+            "hcml_render_fn hcml_find_render( const char *name, size_t length );\n", params) ) break;
+        if ( asset_count > 0 && !hcml_append_code_format(h, 
+            "const hcml::rt::static_content * hcml_find_asset( const char *name, size_t length );\n") 
+        ) break;
+        if ( count == 0 ) {
+            if ( !hcml_append_code_format(h, 
+                "\nhcml_render_fn hcml_find_render( const char *, size_t ) {\n"
+                "    return 0;\n}\n") ) break;
+            if ( asset_count == 0 ) break;
+        }
+        /* Static tables, constant initialized without any startup code */
+        if ( !hcml_append_code_format(h, 
+            "\nnamespace {\n\n"
+            "inline unsigned long long hcml_registry_hash( "
+            "long long seed, const char *s, size_t l ) {\n"
+            "    unsigned long long _h = 14695981039346656037ULL ^ "
+            "((unsigned long long)seed * 0x9E3779B97F4A7C15ULL);\n"
+            "    for ( size_t _i = 0; _i < l; ++_i ) {\n"
+            "        _h ^= (unsigned char)s[_i];\n"
+            "        _h *= 1099511628211ULL;\n"
+            "    }\n"
+            "    return _h;\n"
+            "}\n\n") ) break;
+        if ( count > 0 ) {
+            if ( !hcml_append_code_format(h, 
+                "struct hcml_registry_entry_t {\n"
+                "    const char          *name;\n"
+                "    size_t              length;\n"
+                "    hcml_render_fn      fn;\n"
+                "};\n\n"
+                "const hcml_registry_entry_t hcml_registry_entries[%d] = {\n", count) ) break;
+            for ( _i = 0; _i < count; ++_i ) {
+                hcml_cxx_render_name(names[_slots[_i]], _fn, sizeof(_fn));
+                if ( HCML_ERR_OK != __generate_cxx_registry_name(h, names[_slots[_i]]) ) break;
+                if ( !hcml_append_code_format(h, "&%s },\n", _fn) ) break;
+            }
+            if ( h->errcode != HCML_ERR_OK ) break;
+            if ( !hcml_append_code_format(h, "};\n\n") ) break;
+            if ( HCML_ERR_OK != __generate_cxx_registry_lookup(h, "hcml_registry", _seeds, count, 
+                "hcml_render_fn", "hcml_find_render", "_e.fn") ) break;
+            if ( asset_count > 0 && !hcml_append_code_format(h, "namespace {\n\n") ) break;
+        }
+        if ( asset_count == 0 ) break;
+        for ( _i = 0; _i < asset_count; ++_i ) {
+            if ( HCML_ERR_OK != __generate_cxx_asset(h, _i, assets[_i]) ) break;
+        }
+        if ( h->errcode != HCML_ERR_OK ) break;
+        if ( !hcml_append_code_format(h, 
+            "struct hcml_asset_entry_t {\n"
+            "    const char                          *name;\n"
+            "    size_t                              length;\n"
+            "    const hcml::rt::static_content      *content;\n"
+            "};\n\n"
+            "const hcml_asset_entry_t hcml_asset_entries[%d] = {\n", asset_count) ) break;
+        for ( _i = 0; _i < asset_count; ++_i ) {
+            if ( HCML_ERR_OK != __generate_cxx_registry_name(h, assets[_asset_slots[_i]]) ) break;
+            if ( !hcml_append_code_format(h, "&hcml_asset_%d },\n", _asset_slots[_i]) ) break;
         }
+        if ( h->errcode != HCML_ERR_OK ) break;
+        if ( !hcml_append_code_format(h, "};\n\n") ) break;
+        __generate_cxx_registry_lookup(h, "hcml_asset", _asset_seeds, asset_count, 
+            "const hcml::rt::static_content *", "hcml_find_asset", "_e.content");
     } while ( 0 );
+    __hcml_free(_seeds);
+    __hcml_free(_slots);
+    __hcml_free(_asset_seeds);
+    __hcml_free(_asset_slots);
     return h->errcode;
 }
 
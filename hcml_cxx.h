@@ -39,9 +39,53 @@
 extern "C" {
 #endif
 
-/* Genearte C++ Code according to the parsed tag */
+/* Genearte C++ Code according to the parsed tag, the tag is in the node view */
 int hcml_generate_cxx_lang( hcml_node_t *h, struct hcml_tag_t *root_tag, const char*suf );
 
+/* Genearte C++ Code of the sibling list from the node, stops before stop */
+int hcml_generate_cxx_nodes( hcml_node_t *h, uint32_t node, uint32_t stop, const char *suf );
+
+/* 
+    Generate C++ Code, runs of top-level statements reaching the outline size
+    are moved to the outlined functions
+ */
+int hcml_generate_cxx_outline( hcml_node_t *h, uint32_t root, const char*suf );
+
+/* Make the name of the generated file for the #line directives back to it */
+int hcml_prepare_cxx_lines( hcml_node_t *h );
+
+/* Number the #line directives back to the generated file as their next line */
+int hcml_sync_cxx_lines( hcml_node_t *h );
+
+/* 
+    Check the top-level statements can be generated in parallel and load 
+    all included templates, return 0 to generate serially
+ */
+int hcml_prepare_cxx_parallel( hcml_node_t *h, uint32_t root );
+
+/* 
+    Fold constant subtrees to static string or literal before generating,
+    root may be changed or set to HCML_NODE_NONE when nothing left 
+ */
+int hcml_fold_cxx_lang( hcml_node_t *h, uint32_t *root );
+
+/* 
+    Render function name of the template: hcml_render_ and the name with 
+    '_' doubled and other non-alnum chars as _xx hex, return the length 
+    or -1 when the buffer is too small
+ */
+int hcml_cxx_render_name( const char *name, char *buf, int size );
+
+/*
+    Generate the registry of the templates and the assets to the output, 
+    a name is found through a perfect hash computed at generation time.
+    params is the parameter list of the render functions, headers are 
+    included after the standard ones to declare the types in it
+ */
+int hcml_generate_cxx_registry( hcml_node_t *h, const char * const *names, int count, 
+    const char * const *assets, int asset_count, const char *params, 
+    const char * const *headers, int header_count );
+
 #ifdef __cplusplus
 }
 #endif
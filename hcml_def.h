@@ -33,10 +33,115 @@
 #ifndef HCML_HCML_DEF_H_DEF_
 #define HCML_HCML_DEF_H_DEF_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* No node, or no property */
+#define HCML_NODE_NONE              0xFFFFFFFFu
+
+/* Compact node flags */
+#define HCML_CNODE_TAG              0x01
+#define HCML_CNODE_ENDED            0x02
+/* The string, or the tag name, is in the fold data of the table */
+#define HCML_CNODE_FOLDED           0x04
+
+/* Name id of a tag beyond the name table, looked up by the name */
+#define HCML_CNAME_NONE             0xFFFF
+
+/* Compact Node, emitted by the parser in pre-order */
+struct hcml_cnode_t {
+    /* Offset and length of the tag name or the string in the source */
+    uint32_t                    data_off;
+    uint32_t                    data_len;
+    uint32_t                    parent;
+    uint32_t                    child;
+    uint32_t                    next;
+    /* First property in the property table, props of a node are contiguous */
+    uint32_t                    prop;
+    uint32_t                    bline;
+    /* Index in the name table, only for tags */
+    uint16_t                    name_id;
+    uint8_t                     flags;
+    uint8_t                     prop_count;
+};
+
+/* Compact Property, value_off is HCML_NODE_NONE for the bare key */
+struct hcml_cprop_t {
+    uint32_t                    key_off;
+    uint32_t                    key_len;
+    uint32_t                    value_off;
+    uint32_t                    value_len;
+};
+
+/* Tag name in the name table */
+struct hcml_cname_t {
+    uint32_t                    off;
+    uint32_t                    len;
+};
+
+/* Node table of a template */
+struct hcml_node_table_t {
+    const char                  *source;
+    struct hcml_cnode_t         *nodes;
+    uint32_t                    node_count;
+    uint32_t                    node_alloc;
+    struct hcml_cprop_t         *props;
+    uint32_t                    prop_count;
+    uint32_t                    prop_alloc;
+    struct hcml_cname_t         *names;
+    uint32_t                    name_count;
+    /* Folded data of the nodes, NULL until the first node is folded */
+    char                        **fold;
+    /* Pointer tree view of the nodes for the generator plugins, built on the first use */
+    struct hcml_tag_t           *view;
+    struct hcml_prop_t          *view_props;
+    /* Registered tag of each name, resolved when the registry changed */
+    const struct hcml_tag_entry_t   **name_tags;
+    int                         tag_serial;
+};
+
+/* Outlined functions of one shard */
+struct hcml_outline_t {
+    char                        *code;
+    int                         size;
+    int                         bufsize;
+};
+
+/* Included template cache entry */
+struct hcml_include_t {
+    /* Real path of the template */
+    char                        *path;
+    /* Display name of the template, relative to working dir if possible */
+    char                        *name;
+    /* Source buffer, the node table points to it */
+    char                        *sbuf;
+    /* Node table of the template */
+    struct hcml_node_table_t    *table;
+    /* First node, HCML_NODE_NONE when empty */
+    uint32_t                    root;
+    /* 1 when the tree is being folded or generated, for cycle detection */
+    int                         busy;
+    /* 1 when constant folding has been done */
+    int                         folded;
+    struct hcml_include_t       *n_inc;
+};
+
+/* Schema declared by cxx:schema, or a variable bound to one */
+struct hcml_schema_t {
+    /* Name of the schema or the variable, points to the template */
+    const char                  *name;
+    int                         nl;
+    /* The cxx:schema node and its table, the fields are its children */
+    struct hcml_node_table_t    *table;
+    uint32_t                    node;
+    /* The schema a variable is bound to, NULL for a schema */
+    struct hcml_schema_t        *bound;
+    struct hcml_schema_t        *n_schema;
+};
+
 typedef struct {
     /* An error message buffer */
     char                        errmsg[256];
@@ -48,6 +153,8 @@ typedef struct {
     int                         rsize;
     /* Output content */
     char                        *presult;
+    /* Content hash of the output in hex */
+    char                        output_hash[24];
     /* Print Method */
     char                        print_method[128];
     /* Print Method Length */
@@ -60,8 +167,112 @@ typedef struct {
     int                         line;
     /* Language Generator Function Point */
     void                        *langfp;
+    /* User data of the language generator */
+    void                        *lang_userdata;
     /* Extended Language Function Point */
     void                        *exlangfp;
+    /* Registered tags, hashed by name */
+    struct hcml_tag_entry_t     **tag_buckets;
+    /* Bucket count, power of 2 */
+    int                         tag_bucket_size;
+    /* Registered tag count */
+    int                         tag_count;
+    /* Changed every time the registry changed */
+    int                         tag_serial;
+    /* Flush Method */
+    char                        flush_method[128];
+    /* Flush Method Length */
+    int                         flush_method_l;
+    /* Reserve Method, invoked before cxx:each with the static size */
+    char                        reserve_method[128];
+    /* Reserve Method Length */
+    int                         reserve_method_l;
+    /* Auto flush after N bytes of static string, 0 to disable */
+    int                         flush_threshold;
+    /* Static bytes written since last flush point */
+    int                         flush_pending;
+    /* Template line of each generated flush point */
+    int                         *flush_lines;
+    /* Flush point count */
+    int                         flush_count;
+    /* Flush point buffer size */
+    int                         flush_bufsize;
+    /* Render Mode, print method or coroutine */
+    int                         render_mode;
+    /* Node table of the source file being generated */
+    struct hcml_node_table_t    *table;
+    /* Parsing threads, 0 or 1 to parse serially, negative to use all cores */
+    int                         parse_threads;
+    /* Generating threads, 0 or 1 to generate serially, negative to use all cores */
+    int                         generate_threads;
+    /* 1: A copy generating a piece in a worker thread, shared state is read only */
+    int                         is_worker;
+    /* Render probes level */
+    int                         probes;
+    /* Emit #line directives to map the code back to the template */
+    int                         line_directives;
+    /* Name of the generated file in the directives back to it, NULL for the source with .inc */
+    char                        *line_output;
+    /* Escaped name of the generated file of last parse */
+    char                        *line_return;
+    /* 1: The code being generated is numbered as the template */
+    int                         line_in_template;
+    /* Fold constant subtrees at generation time */
+    int                         const_folding;
+    /* 1: The whole template is static string after folding */
+    int                         is_static;
+    /* Static output size when is_static */
+    int                         static_size;
+    /* Content hash of the static output, quoted as an ETag */
+    char                        static_etag[24];
+    /* Static Method, receive the precompressed static template */
+    char                        static_method[128];
+    /* Static Method Length */
+    int                         static_method_l;
+    /* Key Type, constructed with the constant key of cxx:subscript */
+    char                        key_type[128];
+    /* Key Type Length */
+    int                         key_type_l;
+    /* Hash of the constant key, NULL for FNV-1a */
+    unsigned long long          (*key_hash)( const char *, int );
+    /* Real path of the parsing source file */
+    char                        *src_path;
+    /* Source file name, relative to the working directory like the includes */
+    char                        *src_name;
+    /* The included template being generated, NULL for the source file */
+    struct hcml_include_t       *cur_inc;
+    /* Sequence to make unique names in generated code, reset every parse */
+    int                         site_seq;
+    /* Depth of cxx:cache being generated */
+    int                         cache_depth;
+    /* Last node of the straight-line run being generated in raw buffer mode */
+    const struct hcml_cnode_t   *raw_run_last;
+    /* Static bytes left in the run, room has been checked */
+    int                         raw_run_left;
+    /* Included template cache, kept until destroy or clear */
+    struct hcml_include_t       *inc_cache;
+    /* Included templates used by last parse */
+    struct hcml_include_t       **inc_used;
+    /* Used include count */
+    int                         inc_used_count;
+    /* Used include buffer size */
+    int                         inc_used_bufsize;
+    /* Outline top-level statements once N bytes of code, 0 to disable */
+    int                         outline_size;
+    /* Parameters of the outlined functions */
+    char                        *outline_params;
+    /* Arguments to call the outlined functions, names of the parameters */
+    char                        *outline_args;
+    /* Shards of the outlined functions, 0 to make them static in one piece */
+    int                         outline_shards;
+    /* Outlined function count of last parse */
+    int                         outline_count;
+    /* Code of each shard */
+    struct hcml_outline_t       *outlines;
+    /* Allocated shard count */
+    int                         outline_alloc;
+    /* Declared schemas and bound variables of last parse, newest first */
+    struct hcml_schema_t        *schemas;
 } hcml_node_t;
 
 /* Tag Property Node */
@@ -85,6 +296,8 @@ struct hcml_tag_t {
 
     /* Begin Line Number */
     int                     bline;
+    /* Folded static string, already minimized, NULL if in the source */
+    const char              *fold_data;
     struct hcml_prop_t      *p_root;
     struct hcml_tag_t       *c_tag;
     struct hcml_tag_t       *n_tag;
@@ -94,6 +307,19 @@ struct hcml_tag_t {
 /* Function Point to generate final code */
 typedef int (*hcml_lang_generator)( hcml_node_t *, struct hcml_tag_t*, const char*);
 
+/* Function Point to generate a registered tag, with the user data */
+typedef int (*hcml_tag_generator)( hcml_node_t *, struct hcml_tag_t*, const char*, void *);
+
+/* Registered Tag */
+struct hcml_tag_entry_t {
+    char                    *name;
+    int                     nl;
+    unsigned long long      hash;
+    hcml_tag_generator      fn;
+    void                    *userdata;
+    struct hcml_tag_entry_t *n_entry;
+};
+
 #ifdef __cplusplus
 }
 #endif
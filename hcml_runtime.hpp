@@ -0,0 +1,498 @@
+/*
+    hcml_runtime.hpp
+    Project: HCML
+    Author: Push Chen(littlepush)
+    Github: https://github.com/littlepush/hcml
+    Date: 2020-03-20
+
+    MIT License
+
+    Copyright (c) 2020 Push Chen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#ifndef HCML_HCML_RUNTIME_HPP_
+#define HCML_HCML_RUNTIME_HPP_
+
+/*
+    Runtime support for the generated code, header only.
+    This file is included by the code which includes the generated code,
+    not by libhcml itself.
+ */
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+#include <type_traits>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define HCML_RT_HAS_COROUTINE       1
+#include <coroutine>
+#include <exception>
+#include <string_view>
+#include <utility>
+#endif
+
+namespace hcml { namespace rt {
+
+#ifdef HCML_RT_HAS_COROUTINE
+/*
+    Lazy generator for HCML_RENDER_COROUTINE mode, each chunk is valid until
+    the next resume. An empty chunk is yield by cxx:flush.
+
+    hcml::rt::generator< std::string_view > render( request& req ) {
+        #include "page.hcml.cpp"
+    }
+ */
+template < typename _TyChunk = std::string_view >
+class generator {
+public:
+    struct promise_type {
+        _TyChunk                    current_;
+        std::exception_ptr          exception_;
+
+        generator get_return_object() {
+            return generator(std::coroutine_handle< promise_type >::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value( _TyChunk chunk ) noexcept {
+            current_ = chunk;
+            return {};
+        }
+        void return_void() noexcept { }
+        void unhandled_exception() { exception_ = std::current_exception(); }
+    };
+
+    struct sentinel { };
+
+    class iterator {
+        std::coroutine_handle< promise_type >       coro_;
+    public:
+        explicit iterator( std::coroutine_handle< promise_type > c ) : coro_(c) { }
+        const _TyChunk& operator * () const { return coro_.promise().current_; }
+        iterator& operator ++ () {
+            coro_.resume();
+            if ( coro_.done() && coro_.promise().exception_ ) {
+                std::rethrow_exception(coro_.promise().exception_);
+            }
+            return *this;
+        }
+        bool operator == ( sentinel ) const { return coro_.done(); }
+        bool operator != ( sentinel ) const { return !coro_.done(); }
+    };
+
+    explicit generator( std::coroutine_handle< promise_type > c ) : coro_(c) { }
+    generator( const generator& ) = delete;
+    generator( generator&& rhs ) noexcept : coro_(std::exchange(rhs.coro_, nullptr)) { }
+    generator& operator = ( generator&& rhs ) noexcept {
+        if ( this != &rhs ) {
+            if ( coro_ ) coro_.destroy();
+            coro_ = std::exchange(rhs.coro_, nullptr);
+        }
+        return *this;
+    }
+    ~generator() { if ( coro_ ) coro_.destroy(); }
+
+    // Resume the render and get next chunk, return false when finished
+    bool next( _TyChunk& chunk ) {
+        if ( !coro_ || coro_.done() ) return false;
+        coro_.resume();
+        if ( coro_.done() ) {
+            if ( coro_.promise().exception_ ) {
+                std::rethrow_exception(coro_.promise().exception_);
+            }
+            return false;
+        }
+        chunk = coro_.promise().current_;
+        return true;
+    }
+
+    iterator begin() {
+        iterator _it(coro_);
+        ++_it;
+        return _it;
+    }
+    sentinel end() { return {}; }
+
+private:
+    std::coroutine_handle< promise_type >           coro_;
+};
+#endif
+
+/*
+    Bytes of a dynamic value in HCML_RENDER_RAWBUF mode, numbers are
+    formatted into the inline buffer without any allocation
+ */
+class raw_view {
+public:
+    raw_view( const std::string& s ) : data_(s.data()), size_(s.size()) { }
+    // Keep the temporary string until written
+    raw_view( std::string&& s ) : own_(std::move(s)), data_(own_.data()), size_(own_.size()) { }
+    raw_view( const char *s ) : data_(s), size_(std::strlen(s)) { }
+    raw_view( char c ) : data_(buf_), size_(1) { buf_[0] = c; }
+#if __cplusplus >= 201703L
+    raw_view( std::string_view s ) : data_(s.data()), size_(s.size()) { }
+#endif
+    template < typename _TyValue, typename std::enable_if< 
+        std::is_integral< _TyValue >::value && std::is_signed< _TyValue >::value, int >::type = 0 >
+    raw_view( _TyValue v ) : data_(buf_) {
+        size_ = (size_t)std::snprintf(buf_, sizeof(buf_), "%lld", (long long)v);
+    }
+    template < typename _TyValue, typename std::enable_if< 
+        std::is_integral< _TyValue >::value && !std::is_signed< _TyValue >::value, int >::type = 0 >
+    raw_view( _TyValue v ) : data_(buf_) {
+        size_ = (size_t)std::snprintf(buf_, sizeof(buf_), "%llu", (unsigned long long)v);
+    }
+    template < typename _TyValue, typename std::enable_if< 
+        std::is_floating_point< _TyValue >::value, int >::type = 0 >
+    raw_view( _TyValue v ) : data_(buf_) {
+        size_ = (size_t)std::snprintf(buf_, sizeof(buf_), "%g", (double)v);
+    }
+    raw_view( const raw_view& ) = delete;
+    raw_view& operator = ( const raw_view& ) = delete;
+
+    const char * data() const { return data_; }
+    size_t size() const { return size_; }
+private:
+    char                            buf_[32];
+    std::string                     own_;
+    const char                      *data_;
+    size_t                          size_;
+};
+
+/*
+    Render probes, generated by hcml_set_probes. Every probe site is a 
+    static object in the render code, linked in a global table
+ */
+class probe_site {
+public:
+    const char                          *name;
+    int                                 line;
+    const char                          *kind;
+    std::atomic< unsigned long long >   count;
+    std::atomic< unsigned long long >   bytes;
+    std::atomic< unsigned long long >   cycles;
+    probe_site                          *next;
+
+    probe_site( const char *n, int l, const char *k ) 
+        : name(n), line(l), kind(k), count(0), bytes(0), cycles(0), next(nullptr)
+    {
+        next = head().load();
+        while ( !head().compare_exchange_weak(next, this) ) { }
+    }
+    probe_site( const probe_site& ) = delete;
+    probe_site& operator = ( const probe_site& ) = delete;
+
+    // The last registered site
+    static std::atomic< probe_site * >& head() {
+        static std::atomic< probe_site * > _head(nullptr);
+        return _head;
+    }
+};
+
+// Bytes written by current thread, only counted in the generated code with probes
+inline unsigned long long& probe_bytes() {
+    static thread_local unsigned long long _bytes = 0;
+    return _bytes;
+}
+
+// Cycle counter, or steady clock in nanoseconds
+inline unsigned long long probe_clock() {
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+    return __builtin_ia32_rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast< std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Count one execution of the site and the bytes written in the scope
+template < bool _cycles >
+class probe_scope {
+public:
+    explicit probe_scope( probe_site& s ) 
+        : site_(s), bytes_(probe_bytes()), begin_(_cycles ? probe_clock() : 0) { }
+    ~probe_scope() {
+        site_.count.fetch_add(1, std::memory_order_relaxed);
+        site_.bytes.fetch_add(probe_bytes() - bytes_, std::memory_order_relaxed);
+        if ( _cycles ) site_.cycles.fetch_add(probe_clock() - begin_, std::memory_order_relaxed);
+    }
+    probe_scope( const probe_scope& ) = delete;
+    probe_scope& operator = ( const probe_scope& ) = delete;
+private:
+    probe_site                      &site_;
+    unsigned long long              bytes_;
+    unsigned long long              begin_;
+};
+
+// Size of a printed value, 0 if unknown
+inline size_t probe_size( const std::string& v ) { return v.size(); }
+inline size_t probe_size( const char *v ) { return std::strlen(v); }
+#if __cplusplus >= 201703L
+inline size_t probe_size( std::string_view v ) { return v.size(); }
+#endif
+template < typename _TyValue >
+inline typename std::enable_if< std::is_arithmetic< _TyValue >::value, size_t >::type 
+probe_size( _TyValue v ) { return raw_view(v).size(); }
+template < typename _TyValue >
+inline typename std::enable_if< !std::is_arithmetic< _TyValue >::value &&
+    !std::is_convertible< const _TyValue&, const char * >::value, size_t >::type
+probe_size( const _TyValue& ) { return 0; }
+
+// Count the bytes of a printed value and pass it to the print method
+template < typename _TyValue >
+inline _TyValue&& probe_write( _TyValue&& v ) {
+    probe_bytes() += probe_size(v);
+    return std::forward< _TyValue >(v);
+}
+
+// Dump all probe sites as "template:line kind count bytes cycles"
+template < typename _TyStream >
+inline void probe_dump( _TyStream& os ) {
+    for ( probe_site *_s = probe_site::head().load(); _s != nullptr; _s = _s->next ) {
+        os << _s->name << ":" << _s->line << " " << _s->kind << " " 
+            << _s->count.load() << " " << _s->bytes.load() << " " << _s->cycles.load() << "\n";
+    }
+}
+
+// Reset the counters of all probe sites
+inline void probe_reset() {
+    for ( probe_site *_s = probe_site::head().load(); _s != nullptr; _s = _s->next ) {
+        _s->count.store(0);
+        _s->bytes.store(0);
+        _s->cycles.store(0);
+    }
+}
+
+/*
+    A fully static template, passed to the static method, or an embedded asset
+    found by hcml_find_asset. The compressed variants are computed at 
+    generation time, null when zlib is not available or they are not smaller
+
+    void send_static( const hcml::rt::static_content& c ) {
+        if ( req.header("If-None-Match") == c.etag ) { reply(304); return; }
+        if ( c.gzip != nullptr && req.accept_encoding("gzip") ) { ... }
+    }
+ */
+struct static_content {
+    const char                      *data;
+    size_t                          size;
+    const unsigned char             *gzip;
+    size_t                          gzip_size;
+    const unsigned char             *deflate;
+    size_t                          deflate_size;
+    // Quoted content hash
+    const char                      *etag;
+    // MIME type, text/html for a template
+    const char                      *mime;
+};
+
+/*
+    64-bit FNV-1a hash of a key, the default hash of the constant subscript key
+    computed at generation time, to look up a runtime key the same way
+ */
+inline unsigned long long key_hash( const char *data, size_t size ) {
+    unsigned long long _h = 14695981039346656037ULL;
+    for ( size_t i = 0; i < size; ++i ) {
+        _h ^= (unsigned char)data[i];
+        _h *= 1099511628211ULL;
+    }
+    return _h;
+}
+
+/*
+    Constant subscript key generated by hcml_set_key_type, the length and 
+    the hash are computed at generation time
+
+    const value& object::operator[]( const hcml::rt::hashed_key& k ) const {
+        return this->find(k.hash, k.data, k.size);
+    }
+ */
+struct hashed_key {
+    const char                      *data;
+    size_t                          size;
+    unsigned long long              hash;
+
+    constexpr hashed_key( const char *d, size_t s, unsigned long long h ) 
+        : data(d), size(s), hash(h) { }
+};
+
+/*
+    Side buffer for the body of cxx:cache, accept what the print method accepts
+ */
+class fragment_buffer {
+public:
+    void write( const char *data, size_t size ) { data_.append(data, size); }
+    void write( const char *data ) { data_.append(data); }
+    void write( const std::string& data ) { data_.append(data); }
+#if __cplusplus >= 201703L
+    void write( std::string_view data ) { data_.append(data.data(), data.size()); }
+#endif
+    template < typename _TyValue >
+    void write( const _TyValue& value ) {
+        std::ostringstream _oss;
+        _oss << value;
+        data_.append(_oss.str());
+    }
+    std::string release() { return std::move(data_); }
+private:
+    std::string                                     data_;
+};
+
+/* Hit rate counters of all fragment caches */
+struct fragment_cache_stats_t {
+    unsigned long long              hits;
+    unsigned long long              misses;
+    unsigned long long              stores;
+    unsigned long long              evictions;
+};
+
+/*
+    Rendered fragments of cxx:cache, one cache per thread so no lock is 
+    taken when rendering. An entry is replaced when the version changes, 
+    and the whole cache is dropped when reaching the entry limit.
+ */
+class fragment_cache {
+public:
+    typedef std::shared_ptr< const std::string >    data_t;
+
+    // The cache of current thread
+    static fragment_cache& local() {
+        static thread_local fragment_cache _cache;
+        return _cache;
+    }
+
+    // Max entries count of every thread, default is 1024
+    static std::atomic< size_t >& max_entries() {
+        static std::atomic< size_t > _max(1024);
+        return _max;
+    }
+
+    // Make the key string of the key expression
+    static std::string to_key( const std::string& key ) { return key; }
+    static std::string to_key( const char *key ) { return std::string(key); }
+    template < typename _TyKey >
+    static std::string to_key( const _TyKey& key ) {
+        std::ostringstream _oss;
+        _oss << key;
+        return _oss.str();
+    }
+
+    // Find the fragment of the site, null when missing or out of date
+    data_t find( const char *site, const std::string& key, unsigned long long version ) {
+        auto _it = entries_.find(make_key_(site, key));
+        if ( _it == entries_.end() || _it->second.version != version ) {
+            counters_->misses.fetch_add(1, std::memory_order_relaxed);
+            return data_t();
+        }
+        counters_->hits.fetch_add(1, std::memory_order_relaxed);
+        return _it->second.data;
+    }
+
+    // Store the rendered fragment and return it
+    data_t store( const char *site, const std::string& key, 
+        unsigned long long version, std::string&& data ) 
+    {
+        std::string _k = make_key_(site, key);
+        if ( entries_.size() >= max_entries().load() && entries_.find(_k) == entries_.end() ) {
+            counters_->evictions.fetch_add(entries_.size(), std::memory_order_relaxed);
+            entries_.clear();
+        }
+        entry_t& _e = entries_[_k];
+        _e.version = version;
+        _e.data = std::make_shared< const std::string >(std::move(data));
+        counters_->stores.fetch_add(1, std::memory_order_relaxed);
+        return _e.data;
+    }
+
+    // Drop all fragments of current thread
+    void clear() { entries_.clear(); }
+
+    // Sum the counters of all threads, include the exited ones
+    static fragment_cache_stats_t stats() {
+        fragment_cache_stats_t _s = { 0, 0, 0, 0 };
+        std::lock_guard< std::mutex > _l(registry_().lock);
+        for ( auto& _c : registry_().counters ) {
+            _s.hits += _c->hits.load(std::memory_order_relaxed);
+            _s.misses += _c->misses.load(std::memory_order_relaxed);
+            _s.stores += _c->stores.load(std::memory_order_relaxed);
+            _s.evictions += _c->evictions.load(std::memory_order_relaxed);
+        }
+        return _s;
+    }
+
+    fragment_cache() : counters_(std::make_shared< counters_t >()) {
+        std::lock_guard< std::mutex > _l(registry_().lock);
+        registry_().counters.push_back(counters_);
+    }
+    fragment_cache( const fragment_cache& ) = delete;
+    fragment_cache& operator = ( const fragment_cache& ) = delete;
+
+private:
+    struct entry_t {
+        unsigned long long          version;
+        data_t                      data;
+    };
+    struct counters_t {
+        std::atomic< unsigned long long >   hits{0};
+        std::atomic< unsigned long long >   misses{0};
+        std::atomic< unsigned long long >   stores{0};
+        std::atomic< unsigned long long >   evictions{0};
+    };
+    struct registry_t {
+        std::mutex                                      lock;
+        std::vector< std::shared_ptr< counters_t > >    counters;
+    };
+    static registry_t& registry_() {
+        static registry_t _r;
+        return _r;
+    }
+    static std::string make_key_( const char *site, const std::string& key ) {
+        std::string _k(site);
+        _k.push_back('\0');
+        _k.append(key);
+        return _k;
+    }
+
+    std::unordered_map< std::string, entry_t >      entries_;
+    std::shared_ptr< counters_t >                   counters_;
+};
+
+// Hit rate counters of cxx:cache in all threads
+inline fragment_cache_stats_t fragment_cache_stats() {
+    return fragment_cache::stats();
+}
+
+}}
+
+#endif /*
+    __hcml_runtime.hpp__
+    Push Chen
+*/
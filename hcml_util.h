@@ -39,23 +39,66 @@
 extern "C" {
 #endif
 
-/* Create and init a new prop node */
-struct hcml_prop_t * __malloc_prop( const char * key, int kl );
-
-/* Set the prop's value */
-void __set_prop_value( struct hcml_prop_t * p, const char * value, int vl );
-
-/* Free a property node and all it's siblings */
-void __free_prop( struct hcml_prop_t * p );
-
-/* Create and init a new tag node */
-struct hcml_tag_t * __malloc_tag( const char * key, int kl );
-
-/* Create and init a string tag node */
-struct hcml_tag_t * __malloc_string( const char * value, int vl );
-
-/* Free a tag node, and all it's properies and children and siblings */
-void __free_tag( struct hcml_tag_t * t );
+/* Value of a property without value */
+extern const char *__value_true;
+
+/* Allocation of the library, through the allocator set by hcml_set_allocator */
+void * __hcml_malloc( size_t size );
+void * __hcml_calloc( size_t count, size_t size );
+void * __hcml_realloc( void *ptr, size_t size );
+void __hcml_free( void *ptr );
+char * __hcml_strdup( const char *s );
+
+/* Read the whole file into a new allocated buffer, return the size or -1 */
+int __read_source_file( hcml_node_t *h, const char *path, char **buf );
+
+/* 64bit FNV-1a hash of the data */
+unsigned long long __hash_fnv1a( const char *s, int l );
+
+/* Create an empty node table, the offsets of the nodes are relative to the source */
+struct hcml_node_table_t * __new_node_table( const char *source );
+
+/* 
+    Parse the code into the node table, the code begins at the line.
+    Return the first node, HCML_NODE_NONE if no node
+ */
+uint32_t __parse_hcml_tree__( 
+    hcml_node_t *h, struct hcml_node_table_t *t, const char *rbuf, int rbufl, int line );
+
+/* Minimum bytes of a piece when parsing in parallel */
+#define __PARSE_PIECE_MIN_SIZE__        (64 * 1024)
+
+/* Parse the code into a new node table with threads, root is set to the first node */
+struct hcml_node_table_t * __parse_hcml_tree_parallel__( 
+    hcml_node_t *h, const char *rbuf, int rbufl, uint32_t *root );
+
+/* 
+    Give every tag name an id in the name table, the tags beyond the name
+    table, or all tags when failed to alloc, are looked up by the name
+ */
+void __name_node_table( struct hcml_node_table_t *t );
+
+/* Minimum nodes of a piece when generating in parallel */
+#define __GENERATE_PIECE_MIN_NODES__    1024
+
+/* 
+    Generate the top-level statements with threads, return 0 when the 
+    template must be generated serially
+ */
+int __generate_hcml_parallel__( hcml_node_t *h, uint32_t root );
+
+/* Free the node table, the folded data and the view */
+void __free_node_table( struct hcml_node_table_t *t );
+
+/* Free the pointer tree view of the node table, the nodes have been changed */
+void __free_node_view( struct hcml_node_table_t *t );
+
+/* Build the pointer tree view of the node table, return 0 when failed to alloc */
+int __build_node_view( struct hcml_node_table_t *t );
+
+/* Find the registered tag of the node in the node table, NULL if not registered */
+const struct hcml_tag_entry_t * __find_node_tag( 
+    hcml_node_t *h, struct hcml_node_table_t *t, uint32_t node );
 
 /* Set the error message */
 #define __set_error__(h, args...)   hcml_set_error((hcml_t)h, args)